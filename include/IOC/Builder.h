@@ -6,10 +6,17 @@
 #include "DLObject.h"
 #include "detail/ObjectLoader.h"
 #include "detail/RecursiveExpression.h"
+#include "detail/Profiling.h"
 #include <typeinfo>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <atomic>
+#include <mutex>
 #include <Utility/getType.h>
 
 namespace IOC {
@@ -52,6 +59,16 @@ public:
 	virtual void bindParams( const ObjectLoader & objectLoader )
 	{
 	}
+
+	// Once bound, adds the builders of the objects this one's object is made from. Returns
+	// false if they are not known, in which case nothing is constructed concurrently
+	virtual bool dependencies( std::vector< const Builder * > & /*deps*/ ) const
+	{
+		return false;
+	}
+
+	// creates the object now if it has not been created yet, without returning it
+	virtual void construct() const = 0;
 	
 	std::string type() const
 	{
@@ -74,6 +91,41 @@ protected:
     void circularCheck() const;
 };
 
+// The allocator a builder constructs a CLASS_TYPE with when it can put the object and its
+// reference count in one allocation. Specialise it to use your own for a class; it must be
+// default constructible.
+template< typename CLASS_TYPE >
+struct object_allocator_traits
+{
+	typedef std::allocator< CLASS_TYPE > allocator_type;
+};
+
+template< typename SPTR_TYPE > struct is_std_shared_ptr : std::false_type {};
+template< typename T > struct is_std_shared_ptr< std::shared_ptr< T > > : std::true_type {};
+
+// whether makeObject puts a CLASS_TYPE constructed from ARGS in one allocation with its
+// reference count. It needs a std::shared_ptr and a public constructor
+template< typename CLASS_TYPE, typename SPTR_TYPE, typename... ARGS >
+struct allocates_shared : std::integral_constant< bool,
+	is_std_shared_ptr< SPTR_TYPE >::value && std::is_constructible< CLASS_TYPE, ARGS... >::value >
+{
+};
+
+// Constructs a CLASS_TYPE from args into SPTR_TYPE, through allocate_shared if it can
+template< typename CLASS_TYPE, typename SPTR_TYPE, typename... ARGS >
+SPTR_TYPE makeObject( ARGS &&... args )
+{
+	if constexpr( allocates_shared< CLASS_TYPE, SPTR_TYPE, ARGS &&... >::value )
+	{
+		return std::allocate_shared< CLASS_TYPE >
+			( typename object_allocator_traits< CLASS_TYPE >::allocator_type(), std::forward< ARGS >( args )... );
+	}
+	else
+	{
+		return SPTR_TYPE( new CLASS_TYPE( std::forward< ARGS >( args )... ) );
+	}
+}
+
 // Traits type for smart pointers.
  
 // Note: You virtually never write one of these, instead you use BuilderNParams 
@@ -89,41 +141,76 @@ public:
 private:
 	mutable sptr_type m_object;
 
+	// Objects can be constructed concurrently. m_object is set once, under the lock, which
+	// the thread creating it holds while it creates everything it is made from
+	mutable std::atomic< bool > m_created;
+	mutable std::recursive_mutex m_mutex;
+
 protected:
 	
 	BuilderT( str_cref alias, expr_cref expr )
-		: Builder( alias, expr )
+		: Builder( alias, expr ), m_created( false )
 	{
 	}
 
   // final class must implement the instance of the shared_ptr
 	virtual value_type * createObject() const = 0;
 
+	// creates the object in its smart pointer. Builders that can allocate it together with
+	// its reference count override this
+	virtual sptr_type createShared() const
+	{
+		return sptr_type( createObject() );
+	}
+
 public:
+	// If another thread is creating the object this waits for it. Only the thread that is
+	// creating it can ask for it again while it does, which is a circular reference.
 	sptr_type getObject() const
 	{
-		if( !m_object )
+		if( m_created.load( std::memory_order_acquire ) )
+		{
+			return m_object;
+		}
+
+		std::lock_guard< std::recursive_mutex > lock( m_mutex );
+		if( !m_created.load( std::memory_order_relaxed ) )
 		{
 		    circularCheck();
 			m_creating = true;
 			if( !alias().empty() )
 			{
-				std::clog << "Creating " << alias() << '\n';
+				std::clog << ( "Creating " + alias() + '\n' );
 			}
 
 			// assumed to be supported by all smart pointers, while
 			// .reset() might not be.
 
-			m_object = SPTR_TYPE( createObject() );
+			try
+			{
+				detail::ProfileScope timing( detail::EConstructPhase, *this );
+				m_object = createShared();
+			}
+			catch( ... ) // so asking again reports the same error, not a circular reference
+			{
+				m_creating = false;
+				throw;
+			}
 			
 			if( !alias().empty() )
 			{
-				std::clog << "Finished creating " << alias() << '\n';
+				std::clog << ( "Finished creating " + alias() + '\n' );
 			}
 			m_creating = false;
+			m_created.store( true, std::memory_order_release );
 		}
 		return m_object;
 	}
+
+	void construct() const
+	{
+		getObject();
+	}
 };
 
 template < typename BUILDER_TYPE > void builder_cast
@@ -11,6 +11,9 @@
 // meta-types we use in the implementation below
 
 #include "detail/BuilderParamBinders.h" 
+#include <exception>
+#include <tuple>
+#include <utility>
 
 // this file is really an extension of Builder and you need to include this file to create
 // builders, not Builder.h
@@ -18,29 +21,50 @@
 namespace IOC {
 
 // Builder0Params is a special case which
-// does not derive from BuilderNParams. That is because BuilderNParams
+// is not a BuilderParams. That is because BuilderParams
 // implements bindParams() which is a no-op for Builder0Params
 
 template < typename CLASS_TYPE, typename BASE_TYPE, typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE> >
 class Builder0Params : public BuilderT< BASE_TYPE, SPTR_TYPE >
 {
 public:
+	// what it constructs, and its parameters as declared
+	typedef CLASS_TYPE class_type;
+	typedef std::tuple<> param_types;
+
 	Builder0Params( str_cref alias, expr_cref expr )
 		: BuilderT<BASE_TYPE>( alias, expr )
 	{
 	}
 
+	bool dependencies( std::vector< const Builder * > & ) const
+	{
+		return true;
+	}
+
 	CLASS_TYPE * createObject() const
 	{
 		return new CLASS_TYPE;
 	}
+
+	SPTR_TYPE createShared() const
+	{
+		if constexpr( allocates_shared< CLASS_TYPE, SPTR_TYPE >::value )
+		{
+			return makeObject< CLASS_TYPE, SPTR_TYPE >();
+		}
+		else // the constructor may be one only the builder can call
+		{
+			return SPTR_TYPE( createObject() );
+		}
+	}
 };
 
 // The base class that implements bindParams() for any number of parameters (except 0)
+// through an array of ParamBinderBase pointers. The builders below no longer use it, it is
+// kept for builders written against it.
 template< typename BASE_TYPE, size_t N, typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE> >
 class BuilderNParams : public BuilderT< BASE_TYPE, SPTR_TYPE >
-	// acts as base type to all the others (except 0)
-	// Does not derive from Builder so you need to derive twice
 {
     using BuilderT<BASE_TYPE, SPTR_TYPE>::alias;
     using BuilderT<BASE_TYPE, SPTR_TYPE>::m_creating;
@@ -65,7 +89,7 @@ public:
 
 		this->circularCheck();
 
-		std::vector< RecursiveExpressionPtr > const& params = this->expr().params();
+		ExpressionSpan params = this->expr().params();
 		if( params.size() != N )
 		{
 			this->raiseInvalidParameterCountError( N, params.size() );
@@ -74,68 +98,179 @@ public:
 		// so we have a matching size, so...
 		for( size_t i = 0; i < N; ++i )
 		{
-			binders[i]->bind( loader, *params[i] );
+			binders[i]->bind( loader, params.at( i ) );
 		}
 		this->m_creating = false;
 	}
+
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		bool known = true;
+		for( size_t i = 0; i < N && known; ++i )
+		{
+			known = binders[i]->dependencies( deps );
+		}
+		return known;
+	}
 };
 
 
-template < typename CLASS_TYPE, typename BASE_TYPE, typename PARAM1, 
-	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE> >
-class Builder1Param : public BuilderNParams< BASE_TYPE, 1, SPTR_TYPE >
+// The famous Builder3Params. Google for this and "variadic templates" and you'll
+// find a post on comp.std.c++ or the archive of it here:
+// http://www.mofeel.net/1176-comp-std-c++/1520.aspx
+// Now that we have variadic templates that is what it is: one builder for any number of
+// parameters, with the binders held by value in a tuple so each is bound and read through its
+// own type rather than through a ParamBinderBase pointer.
+// BuilderSptrParams takes the smart pointer type ahead of the parameters as the pack must come
+// last. You normally use BuilderParams, or the Builder1Param..Builder10Params names below.
+
+template < typename CLASS_TYPE, typename BASE_TYPE, typename SPTR_TYPE, typename... PARAMS >
+class BuilderSptrParams : public BuilderT< BASE_TYPE, SPTR_TYPE >
 {
+public:
+	// what it constructs, and its parameters as declared
+	typedef CLASS_TYPE class_type;
+	typedef std::tuple< PARAMS... > param_types;
+
 protected:
-	ParameterBinder<PARAM1> binder1;
+	typedef std::tuple< ParameterBinder< PARAMS >... > binders_type;
+	typedef std::index_sequence_for< PARAMS... > indexes_type;
+
+	mutable binders_type m_binders; // what they hold is moved out by createObject()
+
+	// createObject() can only take the parameters once so this is what it threw, if it did
+	mutable std::exception_ptr m_failure;
 
 public:
-	Builder1Param( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 1, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders )
+	BuilderSptrParams( str_cref alias, expr_cref expr )
+		: BuilderSptrParams( alias, expr, indexes_type() )
+	{
+	}
+
+	void bindParams( ObjectLoader const& loader )
+	{
+		if( !this->alias().empty() )
+		{
+			std::clog << "Binding parameters for " << this->alias() << '\n';
+		}
+
+		this->circularCheck();
+
+		ExpressionSpan params = this->expr().params();
+		if( params.size() != sizeof...( PARAMS ) )
+		{
+			this->raiseInvalidParameterCountError( sizeof...( PARAMS ), params.size() );
+		}
+
+		// so we have a matching size, so...
+		bindEach( loader, params, indexes_type() );
+		this->m_creating = false;
+	}
+
+	bool dependencies( std::vector< const Builder * > & deps ) const
 	{
+		return dependenciesOfEach( deps, indexes_type() );
 	}
 
 protected:
+	// the parameters are moved in, so a constructor taking T&& or T by value does not copy them.
+	// If it fails, asking again throws the same error
 	CLASS_TYPE * createObject() const
 	{
-		return new CLASS_TYPE( binder1.obj() );
+		return fromParams
+		  (
+			[]( auto &&... params )
+			{
+				return new CLASS_TYPE( std::forward< decltype( params ) >( params )... );
+			}
+		  );
 	}
-};
 
-template
- < typename CLASS_TYPE, typename BASE_TYPE, 
-	typename PARAM1, typename PARAM2,
-	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
- > 
-class Builder2Params : public BuilderNParams< BASE_TYPE, 2, SPTR_TYPE >
-{
-protected:
-	ParameterBinder<PARAM1> binder1;
-	ParameterBinder<PARAM2> binder2;
+	// the object and its reference count share one allocation when SPTR_TYPE allows it
+	SPTR_TYPE createShared() const
+	{
+		if constexpr( allocates_shared< CLASS_TYPE, SPTR_TYPE,
+			decltype( std::declval< ParameterBinder< PARAMS > & >().take() )... >::value )
+		{
+			return fromParams
+			  (
+				[]( auto &&... params )
+				{
+					return makeObject< CLASS_TYPE, SPTR_TYPE >( std::forward< decltype( params ) >( params )... );
+				}
+			  );
+		}
+		else // the constructor may be one only the builder can call
+		{
+			return SPTR_TYPE( createObject() );
+		}
+	}
 
-public:
-	Builder2Params( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 2, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders ),
-		  binder2( 2, this->binders )
+private:
+	// passes what the binders hold to make, which they can only do once
+	template < typename MAKE >
+	auto fromParams( MAKE make ) const
+	{
+		if( m_failure )
+		{
+			std::rethrow_exception( m_failure );
+		}
+
+		try
+		{
+			return std::apply
+			  ( 
+				[&make]( ParameterBinder< PARAMS > &... binders )
+				{
+					return make( binders.take()... );
+				},
+				m_binders
+			  );
+		}
+		catch( ... )
+		{
+			m_failure = std::current_exception();
+			throw;
+		}
+	}
+
+private:
+	// each binder knows its parameter number for its error messages
+	template < size_t... INDEXES >
+	BuilderSptrParams( str_cref alias, expr_cref expr, std::index_sequence< INDEXES... > )
+		: BuilderT< BASE_TYPE, SPTR_TYPE >( alias, expr ),
+		  m_binders( ( INDEXES + 1 )... )
 	{
 	}
 
-protected:
-	CLASS_TYPE * createObject() const
+	template < size_t... INDEXES >
+	void bindEach( ObjectLoader const& loader, ExpressionSpan params, std::index_sequence< INDEXES... > )
+	{
+		( std::get< INDEXES >( m_binders ).bindParam( loader, params.at( INDEXES ) ), ... );
+	}
+
+	template < size_t... INDEXES >
+	bool dependenciesOfEach( std::vector< const Builder * > & deps, std::index_sequence< INDEXES... > ) const
 	{
-		return new CLASS_TYPE( binder1.obj(), binder2.obj() );
+		return ( std::get< INDEXES >( m_binders ).dependencies( deps ) && ... );
 	}
 };
 
+template < typename CLASS_TYPE, typename BASE_TYPE, typename... PARAMS >
+using BuilderParams = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, spns::shared_ptr< BASE_TYPE >, PARAMS... >;
 
+// The names from before, which take the smart pointer type last
 
-// The famous Builder3Params. Google for this and "variadic templates" and you'll
-// find a post on comp.std.c++ or the archive of it here:
-// http://www.mofeel.net/1176-comp-std-c++/1520.aspx
-// Since then though I have improved it by getting the bindParams bit done polymorphic...
-// Of course C++11 will have initializer lists and our classes might use those,
-// so not sure Douglas Gregor's solution will be totally accurate
+template < typename CLASS_TYPE, typename BASE_TYPE, typename PARAM1, 
+	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE> >
+using Builder1Param = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, PARAM1 >;
+
+template
+ < typename CLASS_TYPE, typename BASE_TYPE, 
+	typename PARAM1, typename PARAM2,
+	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
+ > 
+using Builder2Params = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, PARAM1, PARAM2 >;
 
 template
   < 
@@ -143,31 +278,7 @@ template
 	typename PARAM1, typename PARAM2, typename PARAM3,
 	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
   > 
-class Builder3Params : public BuilderNParams< BASE_TYPE, 3, SPTR_TYPE >
-{
-protected:
-	ParameterBinder<PARAM1> binder1;
-	ParameterBinder<PARAM2> binder2;
-	ParameterBinder<PARAM3> binder3;
-
-public:
-	Builder3Params( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 3, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders ),
-		  binder2( 2, this->binders ),
-		  binder3( 3, this->binders )
-	{
-	}
-
-protected:
-	CLASS_TYPE * createObject() const
-	{
-		return new CLASS_TYPE
-		  ( 
-			binder1.obj(), binder2.obj(), binder3.obj()
-		  );
-	}
-};
+using Builder3Params = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, PARAM1, PARAM2, PARAM3 >;
 
 template
   < 
@@ -176,34 +287,8 @@ template
 	typename PARAM4,
 	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
   > 
-class Builder4Params : public BuilderNParams< BASE_TYPE, 4, SPTR_TYPE >
-{
-protected:
-	ParameterBinder<PARAM1> binder1;
-	ParameterBinder<PARAM2> binder2;
-	ParameterBinder<PARAM3> binder3;
-	ParameterBinder<PARAM4> binder4;
-
-public:
-	Builder4Params( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 4, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders ),
-		  binder2( 2, this->binders ),
-		  binder3( 3, this->binders ),
-		  binder4( 4, this->binders )
-	{
-	}
-
-protected:
-	CLASS_TYPE * createObject() const
-	{
-		return new CLASS_TYPE
-		  ( 
-			binder1.obj(), binder2.obj(), binder3.obj(),
-			binder4.obj()
-		  );
-	}
-};
+using Builder4Params = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, 
+	PARAM1, PARAM2, PARAM3, PARAM4 >;
 
 template
   < 
@@ -212,36 +297,8 @@ template
 	typename PARAM4, typename PARAM5,
 	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
   > 
-class Builder5Params : public BuilderNParams< BASE_TYPE, 5, SPTR_TYPE >
-{
-protected:
-	ParameterBinder<PARAM1> binder1;
-	ParameterBinder<PARAM2> binder2;
-	ParameterBinder<PARAM3> binder3;
-	ParameterBinder<PARAM4> binder4;
-	ParameterBinder<PARAM5> binder5;
-
-public:
-	Builder5Params( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 5, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders ),
-		  binder2( 2, this->binders ),
-		  binder3( 3, this->binders ),
-		  binder4( 4, this->binders ),
-		  binder5( 5, this->binders )
-	{
-	}
-
-protected:
-	CLASS_TYPE * createObject() const
-	{
-		return new CLASS_TYPE
-		  ( 
-			binder1.obj(), binder2.obj(), binder3.obj(),
-			binder4.obj(), binder5.obj()
-		  );
-	}
-};
+using Builder5Params = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, 
+	PARAM1, PARAM2, PARAM3, PARAM4, PARAM5 >;
 
 template
   < 
@@ -250,38 +307,8 @@ template
 	typename PARAM4, typename PARAM5, typename PARAM6,
 	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
   > 
-class Builder6Params : public BuilderNParams< BASE_TYPE, 6, SPTR_TYPE >
-{
-protected:
-	ParameterBinder<PARAM1> binder1;
-	ParameterBinder<PARAM2> binder2;
-	ParameterBinder<PARAM3> binder3;
-	ParameterBinder<PARAM4> binder4;
-	ParameterBinder<PARAM5> binder5;
-	ParameterBinder<PARAM6> binder6;
-
-public:
-	Builder6Params( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 6, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders ),
-		  binder2( 2, this->binders ),
-		  binder3( 3, this->binders ),
-		  binder4( 4, this->binders ),
-		  binder5( 5, this->binders ),
-		  binder6( 6, this->binders )
-	{
-	}
-
-protected:
-	CLASS_TYPE * createObject() const
-	{
-		return new CLASS_TYPE
-		  ( 
-			binder1.obj(), binder2.obj(), binder3.obj(),
-			binder4.obj(), binder5.obj(), binder6.obj()
-		  );
-	}
-};
+using Builder6Params = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, 
+	PARAM1, PARAM2, PARAM3, PARAM4, PARAM5, PARAM6 >;
 
 template
   < 
@@ -291,41 +318,8 @@ template
 	typename PARAM7,
 	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
   > 
-class Builder7Params : public BuilderNParams< BASE_TYPE, 7, SPTR_TYPE >
-{
-protected:
-	ParameterBinder<PARAM1> binder1;
-	ParameterBinder<PARAM2> binder2;
-	ParameterBinder<PARAM3> binder3;
-	ParameterBinder<PARAM4> binder4;
-	ParameterBinder<PARAM5> binder5;
-	ParameterBinder<PARAM6> binder6;
-	ParameterBinder<PARAM7> binder7;
-
-public:
-	Builder7Params( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 7, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders ),
-		  binder2( 2, this->binders ),
-		  binder3( 3, this->binders ),
-		  binder4( 4, this->binders ),
-		  binder5( 5, this->binders ),
-		  binder6( 6, this->binders ),
-		  binder7( 7, this->binders )
-	{
-	}
-
-protected:
-	CLASS_TYPE * createObject() const
-	{
-		return new CLASS_TYPE
-		  ( 
-			binder1.obj(), binder2.obj(), binder3.obj(),
-			binder4.obj(), binder5.obj(), binder6.obj(),
-			binder7.obj()
-		  );
-	}
-};
+using Builder7Params = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, 
+	PARAM1, PARAM2, PARAM3, PARAM4, PARAM5, PARAM6, PARAM7 >;
 
 template
   < 
@@ -334,43 +328,9 @@ template
 	typename PARAM4, typename PARAM5, typename PARAM6,
 	typename PARAM7, typename PARAM8,
 	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
-  > class Builder8Params : public BuilderNParams< BASE_TYPE, 8, SPTR_TYPE >
-{
-protected:
-	ParameterBinder<PARAM1> binder1;
-	ParameterBinder<PARAM2> binder2;
-	ParameterBinder<PARAM3> binder3;
-	ParameterBinder<PARAM4> binder4;
-	ParameterBinder<PARAM5> binder5;
-	ParameterBinder<PARAM6> binder6;
-	ParameterBinder<PARAM7> binder7;
-	ParameterBinder<PARAM8> binder8;
-
-public:
-	Builder8Params( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 8, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders ),
-		  binder2( 2, this->binders ),
-		  binder3( 3, this->binders ),
-		  binder4( 4, this->binders ),
-		  binder5( 5, this->binders ),
-		  binder6( 6, this->binders ),
-		  binder7( 7, this->binders ),
-		  binder8( 8, this->binders )
-	{
-	}
-
-protected:
-	CLASS_TYPE * createObject() const
-	{
-		return new CLASS_TYPE
-		  ( 
-			binder1.obj(), binder2.obj(), binder3.obj(),
-			binder4.obj(), binder5.obj(), binder6.obj(),
-			binder7.obj(), binder8.obj()
-		  );
-	}
-};
+  > 
+using Builder8Params = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, 
+	PARAM1, PARAM2, PARAM3, PARAM4, PARAM5, PARAM6, PARAM7, PARAM8 >;
 
 template
   < 
@@ -379,48 +339,11 @@ template
 	typename PARAM4, typename PARAM5, typename PARAM6,
 	typename PARAM7, typename PARAM8, typename PARAM9,
 	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
-  > class Builder9Params : public BuilderNParams< BASE_TYPE, 9, SPTR_TYPE >
-{
-protected:
-	ParameterBinder<PARAM1> binder1;
-	ParameterBinder<PARAM2> binder2;
-	ParameterBinder<PARAM3> binder3;
-	ParameterBinder<PARAM4> binder4;
-	ParameterBinder<PARAM5> binder5;
-	ParameterBinder<PARAM6> binder6;
-	ParameterBinder<PARAM7> binder7;
-	ParameterBinder<PARAM8> binder8;
-	ParameterBinder<PARAM9> binder9;
-
-public:
-	Builder9Params( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 9, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders ),
-		  binder2( 2, this->binders ),
-		  binder3( 3, this->binders ),
-		  binder4( 4, this->binders ),
-		  binder5( 5, this->binders ),
-		  binder6( 6, this->binders ),
-		  binder7( 7, this->binders ),
-		  binder8( 8, this->binders ),
-		  binder9( 9, this->binders )
-	{
-	}
-
-protected:
-	CLASS_TYPE * createObject() const
-	{
-		return new CLASS_TYPE
-		  ( 
-			binder1.obj(), binder2.obj(), binder3.obj(),
-			binder4.obj(), binder5.obj(), binder6.obj(),
-			binder7.obj(), binder8.obj(), binder9.obj()
-		  );
-	}
-};
-		
+  > 
+using Builder9Params = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, 
+	PARAM1, PARAM2, PARAM3, PARAM4, PARAM5, PARAM6, PARAM7, PARAM8, PARAM9 >;
 
-// going up to 10, but could go higher. (Did I go up to 12 before?)
+// these stop at 10, BuilderParams does not
 
 template 
   < 
@@ -430,48 +353,9 @@ template
 	typename PARAM7, typename PARAM8, typename PARAM9,
 	typename PARAM10,
 	typename SPTR_TYPE=spns::shared_ptr<BASE_TYPE>
-  > class Builder10Params : public BuilderNParams< BASE_TYPE, 10, SPTR_TYPE >
-{
-protected:
-	ParameterBinder<PARAM1> binder1;
-	ParameterBinder<PARAM2> binder2;
-	ParameterBinder<PARAM3> binder3;
-	ParameterBinder<PARAM4> binder4;
-	ParameterBinder<PARAM5> binder5;
-	ParameterBinder<PARAM6> binder6;
-	ParameterBinder<PARAM7> binder7;
-	ParameterBinder<PARAM8> binder8;
-	ParameterBinder<PARAM9> binder9;
-	ParameterBinder<PARAM10> binder10;
-
-public:
-	Builder10Params( str_cref alias, expr_cref expr )
-		: BuilderNParams< BASE_TYPE, 10, SPTR_TYPE >( alias, expr ),
-		  binder1( 1, this->binders ),
-		  binder2( 2, this->binders ),
-		  binder3( 3, this->binders ),
-		  binder4( 4, this->binders ),
-		  binder5( 5, this->binders ),
-		  binder6( 6, this->binders ),
-		  binder7( 7, this->binders ),
-		  binder8( 8, this->binders ),
-		  binder9( 9, this->binders ),
-		  binder10( 10, this->binders )
-	{
-	}
-
-protected:
-	CLASS_TYPE * createObject() const
-	{
-		return new CLASS_TYPE
-		  ( 
-			binder1.obj(), binder2.obj(), binder3.obj(),
-			binder4.obj(), binder5.obj(), binder6.obj(),
-			binder7.obj(), binder8.obj(), binder9.obj(),
-			binder10.obj()
-		  );
-	}
-};
+  > 
+using Builder10Params = BuilderSptrParams< CLASS_TYPE, BASE_TYPE, SPTR_TYPE, 
+	PARAM1, PARAM2, PARAM3, PARAM4, PARAM5, PARAM6, PARAM7, PARAM8, PARAM9, PARAM10 >;
 
 // that's it. 
 // When you create a builder you just do this:
@@ -486,6 +370,8 @@ typedef IOC::Builder6Params< MyDerived, MyBase,
 	std::string, bool, double, Foo, std::vector<Bar>, std::map<int, Baz> 
 	> MyBuilder;
 
+// or IOC::BuilderParams< MyDerived, MyBase, std::string, bool, ... > which takes any number
+
 	// this part must not be in a namespace. declspec bit can be replaced with a macro
 	// or use a .def file as an alternative.
 
@@ -0,0 +1,525 @@
+#pragma once
+
+#ifndef IOC_COMPILED_H_
+#define IOC_COMPILED_H_
+
+#include "BuilderNParams.h"
+#include "Runnable.h"
+#include <cstddef>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <iterator>
+#include <utility>
+
+// What the code generated by ioc-compile is written in. It constructs each object straight
+// from the values the config gave it, converting each to what the binder of its parameter
+// would have produced, so it builds what getRunnable() would have without loading a config,
+// opening a library or casting a builder.
+//
+// The values are written as they were in the config and it is the parameter types that
+// choose the conversion, so a value of the wrong type for its parameter fails to compile
+// where getRunnable() would have failed to bind. Values that are only out of range throw,
+// as they do when bound.
+
+namespace IOC { namespace compiled {
+
+// an enumerated value, converted by the Converter given to its EnumParamBinder
+struct Enumerator
+{
+	const char * m_name;
+};
+
+template< typename... ELEMENTS >
+struct List
+{
+	std::tuple< ELEMENTS... > m_elements;
+};
+
+// a List of literals all of the same type, which is generated as an array
+template< typename T >
+struct Literals
+{
+	const T * m_begin;
+	size_t m_size;
+};
+
+template< typename KEY, typename VALUE >
+struct Entry
+{
+	KEY m_key;
+	VALUE m_value;
+};
+
+template< typename... ENTRIES >
+struct Map
+{
+	std::tuple< ENTRIES... > m_entries;
+};
+
+// a long List or Map is written in parts, as a tuple of thousands of elements is too deep to compile
+template< typename... PARTS >
+struct Joined
+{
+	std::tuple< PARTS... > m_parts;
+};
+
+inline Enumerator enumerator( const char * name )
+{
+	Enumerator res = { name };
+	return res;
+}
+
+template< typename... ELEMENTS >
+List< ELEMENTS... > list( ELEMENTS... elements )
+{
+	return List< ELEMENTS... >{ std::tuple< ELEMENTS... >( elements... ) };
+}
+
+template< typename T, size_t N >
+Literals< T > literals( const T (&elements)[N] )
+{
+	return Literals< T >{ elements, N };
+}
+
+template< typename KEY, typename VALUE >
+Entry< KEY, VALUE > entry( KEY key, VALUE value )
+{
+	return Entry< KEY, VALUE >{ key, value };
+}
+
+template< typename... ENTRIES >
+Map< ENTRIES... > map( ENTRIES... entries )
+{
+	return Map< ENTRIES... >{ std::tuple< ENTRIES... >( entries... ) };
+}
+
+template< typename... PARTS >
+Joined< PARTS... > join( PARTS... parts )
+{
+	return Joined< PARTS... >{ std::tuple< PARTS... >( parts... ) };
+}
+
+// Converts what the config gave to what the binder of a parameter declared as PARAM would
+// have produced. Any parameter can also be given an object that is a Proxy for that.
+template< typename PARAM, typename SOURCE >
+decltype( auto ) value( SOURCE const& source );
+
+template< typename T > struct always_false : std::false_type {};
+
+// whether SOURCE points to a Proxy for T
+template< typename SOURCE, typename T, typename = void >
+struct is_proxy_for : std::false_type
+{
+};
+
+template< typename SOURCE, typename T >
+struct is_proxy_for< SOURCE, T, std::void_t< typename SOURCE::element_type > >
+	: std::is_base_of< Proxy< T >, typename SOURCE::element_type >
+{
+};
+
+// There is one of these for each kind of binder. One of your own needs its own.
+template< typename BINDER >
+struct BinderValue
+{
+	static_assert( always_false< BINDER >::value, "ioc-compile does not know how to convert a value for this binder" );
+};
+
+// Converts each part of a Joined as BINDER_VALUE does and appends them
+template< typename BINDER_VALUE, typename OBJECT >
+struct JoinedValue
+{
+	template< typename... PARTS >
+	static OBJECT from( Joined< PARTS... > const& source )
+	{
+		OBJECT res;
+		std::apply( [&res]( PARTS const&... parts )
+			{
+				( BINDER_VALUE::append( res, BINDER_VALUE::from( parts ) ), ... );
+			}, source.m_parts );
+		return res;
+	}
+};
+
+// Only takes the kinds of value the loader would convert to T
+template< typename T >
+struct BinderValue< LitParamBinder< T > >
+{
+	template< typename SOURCE >
+	static T from( SOURCE const& source )
+	{
+		if constexpr( std::is_same< T, bool >::value )
+		{
+			static_assert( std::is_same< SOURCE, bool >::value, "expected boolean (note, numbers do not convert to booleans)" );
+			return source;
+		}
+		else if constexpr( std::is_floating_point< T >::value )
+		{
+			static_assert( std::is_same< SOURCE, long long >::value || std::is_same< SOURCE, double >::value,
+				"expected a number" );
+			return static_cast< T >( source );
+		}
+		else if constexpr( std::is_integral< T >::value && std::is_signed< T >::value )
+		{
+			static_assert( std::is_same< SOURCE, long long >::value, "expected int" );
+			if( source < std::numeric_limits< T >::min() || source > std::numeric_limits< T >::max() )
+			{
+				std::ostringstream oss;
+				oss << "Expected int, got " << source << " which is out of range";
+				throw std::invalid_argument( oss.str() );
+			}
+			return static_cast< T >( source );
+		}
+		else if constexpr( std::is_integral< T >::value )
+		{
+			static_assert( std::is_same< SOURCE, long long >::value, "expected unsigned int" );
+			if( source < 0 || static_cast< unsigned long long >( source ) > std::numeric_limits< T >::max() )
+			{
+				std::ostringstream oss;
+				oss << "Expected unsigned int, got " << source << " Which did not convert (is it negative?)";
+				throw std::invalid_argument( oss.str() );
+			}
+			return static_cast< T >( source );
+		}
+		else // std::string or std::wstring, which is widened as the loader does
+		{
+			static_assert( std::is_same< SOURCE, const char * >::value, "expected a string" );
+			std::string_view str( source );
+			return T( str.begin(), str.end() );
+		}
+	}
+};
+
+template< typename T, typename SPTR_TYPE >
+struct BinderValue< ObjParamBinder< T, SPTR_TYPE > >
+{
+	template< typename OBJECT_PTR >
+	static SPTR_TYPE from( OBJECT_PTR const& object )
+	{
+		return object;
+	}
+};
+
+template< typename T, typename SPTR_TYPE >
+struct BinderValue< RefParamBinder< T, SPTR_TYPE > >
+{
+	template< typename OBJECT_PTR >
+	static T const& from( OBJECT_PTR const& object )
+	{
+		return *object;
+	}
+};
+
+template< typename PROXY_TYPE, typename SPTR_TYPE >
+struct BinderValue< ProxyParamBinder< PROXY_TYPE, SPTR_TYPE > >
+{
+	template< typename OBJECT_PTR >
+	static typename PROXY_TYPE::value_type from( OBJECT_PTR const& proxy )
+	{
+		return proxy->get();
+	}
+};
+
+template< typename E, typename Converter >
+struct BinderValue< EnumParamBinder< E, Converter > >
+{
+	static E from( Enumerator const& source )
+	{
+		Converter conv;
+		return conv( std::string( source.m_name ) );
+	}
+};
+
+template< typename T >
+struct BinderValue< VecParamBinder< T > >
+	: JoinedValue< BinderValue< VecParamBinder< T > >, typename VecParamBinder< T >::object_type >
+{
+	typedef typename VecParamBinder< T >::object_type object_type;
+	using JoinedValue< BinderValue, object_type >::from;
+
+	template< typename... ELEMENTS >
+	static object_type from( List< ELEMENTS... > const& source )
+	{
+		object_type res;
+		res.reserve( sizeof...( ELEMENTS ) );
+		std::apply( [&res]( ELEMENTS const&... elements )
+			{
+				( res.push_back( value< T >( elements ) ), ... );
+			}, source.m_elements );
+		return res;
+	}
+
+	template< typename LITERAL >
+	static object_type from( Literals< LITERAL > const& source )
+	{
+		object_type res;
+		res.reserve( source.m_size );
+		for( size_t i = 0; i < source.m_size; ++i )
+		{
+			res.push_back( value< T >( source.m_begin[i] ) );
+		}
+		return res;
+	}
+
+	static void append( object_type & res, object_type && part )
+	{
+		res.insert( res.end(), std::make_move_iterator( part.begin() ), std::make_move_iterator( part.end() ) );
+	}
+};
+
+template< typename T, template< typename... > class SET >
+struct BinderValue< SetParamBinder< T, SET > >
+	: JoinedValue< BinderValue< SetParamBinder< T, SET > >, typename SetParamBinder< T, SET >::object_type >
+{
+	typedef typename SetParamBinder< T, SET >::object_type object_type;
+	using JoinedValue< BinderValue, object_type >::from;
+
+	template< typename... ELEMENTS >
+	static object_type from( List< ELEMENTS... > const& source )
+	{
+		object_type res;
+		reserveFor( res, sizeof...( ELEMENTS ) );
+		std::apply( [&res]( ELEMENTS const&... elements )
+			{
+				( insert( res, BinderValue< LitParamBinder< T > >::from( elements ) ), ... );
+			}, source.m_elements );
+		return res;
+	}
+
+	template< typename LITERAL >
+	static object_type from( Literals< LITERAL > const& source )
+	{
+		object_type res;
+		reserveFor( res, source.m_size );
+		for( size_t i = 0; i < source.m_size; ++i )
+		{
+			insert( res, BinderValue< LitParamBinder< T > >::from( source.m_begin[i] ) );
+		}
+		return res;
+	}
+
+	static void append( object_type & res, object_type const& part )
+	{
+		for( T const& element : part )
+		{
+			insert( res, element );
+		}
+	}
+
+private:
+	static void insert( object_type & res, T const& element )
+	{
+		if( !res.insert( element ).second )
+		{
+			std::ostringstream oss;
+			oss << "Duplicate value " << element;
+			throw std::invalid_argument( oss.str() );
+		}
+	}
+};
+
+template< typename K, typename V, template< typename... > class MAP >
+struct BinderValue< MapParamBinder< K, V, MAP > >
+	: JoinedValue< BinderValue< MapParamBinder< K, V, MAP > >, typename MapParamBinder< K, V, MAP >::object_type >
+{
+	typedef typename MapParamBinder< K, V, MAP >::object_type object_type;
+	using JoinedValue< BinderValue, object_type >::from;
+
+	template< typename... ENTRIES >
+	static object_type from( Map< ENTRIES... > const& source )
+	{
+		object_type res;
+		reserveFor( res, sizeof...( ENTRIES ) );
+		std::apply( [&res]( ENTRIES const&... entries )
+			{
+				( insert( res, typename object_type::value_type( BinderValue< LitParamBinder< K > >::from( entries.m_key ),
+					value< V >( entries.m_value ) ) ), ... );
+			}, source.m_entries );
+		return res;
+	}
+
+	static void append( object_type & res, object_type const& part )
+	{
+		for( typename object_type::value_type const& entry : part )
+		{
+			insert( res, entry );
+		}
+	}
+
+private:
+	static void insert( object_type & res, typename object_type::value_type const& entry )
+	{
+		if( !res.insert( entry ).second )
+		{
+			std::ostringstream oss;
+			oss << "Duplicate key " << entry.first;
+			throw std::invalid_argument( oss.str() );
+		}
+	}
+};
+
+template< typename K, typename V >
+struct BinderValue< MultiMapParamBinder< K, V > >
+	: JoinedValue< BinderValue< MultiMapParamBinder< K, V > >, typename MultiMapParamBinder< K, V >::object_type >
+{
+	typedef typename MultiMapParamBinder< K, V >::object_type object_type;
+	using JoinedValue< BinderValue, object_type >::from;
+
+	template< typename... ENTRIES >
+	static object_type from( Map< ENTRIES... > const& source )
+	{
+		object_type res;
+		std::apply( [&res]( ENTRIES const&... entries )
+			{
+				( res.insert( typename object_type::value_type( BinderValue< LitParamBinder< K > >::from( entries.m_key ),
+					value< V >( entries.m_value ) ) ), ... );
+			}, source.m_entries );
+		return res;
+	}
+
+	static void append( object_type & res, object_type const& part )
+	{
+		res.insert( part.begin(), part.end() );
+	}
+};
+
+// the flat containers and arrays are converted as a List first, and sorted or checked as their binders do
+
+template< typename T >
+struct BinderValue< FlatSetParamBinder< T > >
+{
+	template< typename SOURCE >
+	static typename FlatSetParamBinder< T >::object_type from( SOURCE const& source )
+	{
+		return FlatSetParamBinder< T >::fromValues( BinderValue< VecParamBinder< T > >::from( source ) );
+	}
+};
+
+template< typename K, typename V >
+struct BinderValue< FlatMapParamBinder< K, V > >
+{
+	typedef std::vector< K > keys_type;
+	typedef std::vector< typename ParameterBinder< V >::object_type > values_type;
+
+	template< typename SOURCE >
+	static typename FlatMapParamBinder< K, V >::object_type from( SOURCE const& source )
+	{
+		keys_type keys;
+		values_type values;
+		collect( keys, values, source );
+		return FlatMapParamBinder< K, V >::fromEntries( std::move( keys ), std::move( values ) );
+	}
+
+private:
+	template< typename... ENTRIES >
+	static void collect( keys_type & keys, values_type & values, Map< ENTRIES... > const& source )
+	{
+		std::apply( [&keys, &values]( ENTRIES const&... entries )
+			{
+				( ( keys.push_back( BinderValue< LitParamBinder< K > >::from( entries.m_key ) ),
+					values.push_back( value< V >( entries.m_value ) ) ), ... );
+			}, source.m_entries );
+	}
+
+	template< typename... PARTS >
+	static void collect( keys_type & keys, values_type & values, Joined< PARTS... > const& source )
+	{
+		std::apply( [&keys, &values]( PARTS const&... parts )
+			{
+				( collect( keys, values, parts ), ... );
+			}, source.m_parts );
+	}
+};
+
+template< typename T, size_t N >
+struct BinderValue< ArrayParamBinder< T, N > >
+{
+	template< typename SOURCE >
+	static typename ArrayParamBinder< T, N >::object_type from( SOURCE const& source )
+	{
+		return ArrayParamBinder< T, N >::fromList( BinderValue< VecParamBinder< T > >::from( source ) );
+	}
+};
+
+// from a number, a string of 1s and 0s, a List of the bits to set or a Proxy for a set of them
+template< typename T >
+struct BinderValue< BitsetParamBinder< T > >
+{
+	typedef BinderValue< LitParamBinder< size_t > > index_value;
+
+	template< typename SOURCE >
+	static T from( SOURCE const& source )
+	{
+		if constexpr( std::is_same< SOURCE, long long >::value )
+		{
+			return T( index_value::from( source ) );
+		}
+		else if constexpr( std::is_same< SOURCE, const char * >::value )
+		{
+			return T( std::string( source ) );
+		}
+		else
+		{
+			T res;
+			for( size_t idx : indexes( source ) )
+			{
+				res.set( idx );
+			}
+			return res;
+		}
+	}
+
+private:
+	template< typename SOURCE >
+	static std::set< size_t > indexes( SOURCE const& source )
+	{
+		if constexpr( is_proxy_for< SOURCE, std::set< size_t > >::value )
+		{
+			return source->get();
+		}
+		else
+		{
+			return BinderValue< SetParamBinder< size_t > >::from( source );
+		}
+	}
+};
+
+template< typename PARAM, typename SOURCE >
+decltype( auto ) value( SOURCE const& source )
+{
+	typedef typename ParameterBinder< PARAM >::object_type object_type;
+	if constexpr( is_proxy_for< SOURCE, object_type >::value )
+	{
+		return object_type( source->get() );
+	}
+	else
+	{
+		return BinderValue< typename binder_traits< PARAM >::binder_type >::from( source );
+	}
+}
+
+template< typename BUILDER_TYPE, size_t... IDX, typename... SOURCES >
+typename BUILDER_TYPE::sptr_type createFrom( std::index_sequence< IDX... >, SOURCES const&... sources )
+{
+	typedef typename BUILDER_TYPE::param_types param_types;
+	return makeObject< typename BUILDER_TYPE::class_type, typename BUILDER_TYPE::sptr_type >
+		( value< typename std::tuple_element< IDX, param_types >::type >( sources )... );
+}
+
+// constructs the object BUILDER_TYPE would have, in the smart pointer it would have used
+template< typename BUILDER_TYPE, typename... SOURCES >
+typename BUILDER_TYPE::sptr_type create( SOURCES... sources )
+{
+	static_assert( std::tuple_size< typename BUILDER_TYPE::param_types >::value == sizeof...( SOURCES ),
+		"wrong number of parameters for this builder" );
+	return createFrom< BUILDER_TYPE >( std::index_sequence_for< SOURCES... >(), sources... );
+}
+
+} }
+
+#endif
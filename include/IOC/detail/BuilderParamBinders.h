@@ -8,10 +8,17 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <array>
+#include <algorithm>
 #include <functional>
 #include <bitset>
+#include <utility>
 
 #include <boost/shared_ptr.hpp> // also supported
+#include <boost/container/flat_map.hpp>
+#include <boost/container/flat_set.hpp>
 
 // First we have some binder types
 namespace IOC {
@@ -24,6 +31,8 @@ template < typename T > class Proxy;
 // the return type differs (essentially to whatever we need for our constructor).
 // (returning boost::any is not an option). 
 // This model also uses meta-programming techniques
+// Each binder also has take(), which is obj() for a builder that constructs its object from
+// it once: it may move out what the binder holds, so obj() is not valid after it.
 
 // We could stick this detail away but it must be included from this file
 class IOC_API ParamBinderBase
@@ -46,10 +55,20 @@ public:
 	// we could manage with this being non-virtual
 	void bind( const ObjectLoader & loader, expr_cref expr );
 
+	// Once bound, adds the builders of any objects the parameter is made from. Returns false
+	// if they are not known, which is assumed of binders that do not say
+	virtual bool dependencies( std::vector< const Builder * > & /*deps*/ ) const
+	{
+		return false;
+	}
+
 protected:
 	virtual void doBind( const ObjectLoader & loader, expr_cref expr ) = 0;
 
 	void handleError( std::exception const& err, str_cref variable ) const;
+
+	// what bind() does with an error from doBind()
+	void handleBindError( std::exception const& err, expr_cref expr ) const;
 };
 
 template < typename T, typename SPTR_TYPE = std::shared_ptr<T> >
@@ -75,6 +94,12 @@ public:
 		builder_cast( param, m_builder );
 	}
 
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		deps.push_back( m_builder.get() );
+		return true;
+	}
+
 	// this method cannot be virtual although it does exist in all versions
 	// as its return types are not co-variant. Until we have variadic templates /
 	// initialization lists, we will need to call this in ones as below
@@ -94,6 +119,12 @@ public:
 				// not returning a value
 		}
 	}
+
+	// the object is shared so there is nothing to move
+	object_type take()
+	{
+		return obj();
+	}
 };
 
 // T should be one of
@@ -123,10 +154,20 @@ public:
 		loader.convert( expr, m_param );
 	}
 
+	bool dependencies( std::vector< const Builder * > & ) const
+	{
+		return true;
+	}
+
 	object_type obj() const // cannot throw here
 	{
 		return m_param;
 	}
+
+	object_type take()
+	{
+		return std::move( m_param );
+	}
 };
 
 // this is supported but requires the user to define binder_traits for their
@@ -153,11 +194,21 @@ public:
 		m_param = loader.toEnum( expr );
 	}
 
+	bool dependencies( std::vector< const Builder * > & ) const
+	{
+		return true;
+	}
+
 	object_type obj() const // calls user overload
 	{
 		Converter conv;
 		return conv( m_param );
 	}
+
+	object_type take()
+	{
+		return obj();
+	}
 };
 		
 // binder_traits and ParamBinder are both meta-programming structs, i.e.
@@ -242,18 +293,31 @@ class VecParamBinder : public ParamBinderBase
 	typedef typename ParameterBinder<T>::object_type element_object_type;
 
 	std::vector< element_binder_type > m_elementBinders;
+public:
+	// what we actually produce
+	typedef std::vector< element_object_type > object_type;
+
+private:
+	// a List of literals that was packed is converted straight into here instead
+	object_type m_literals;
+	bool m_packed;
+
 public:
 	VecParamBinder( size_t paramNum = 0, ParamBinderBase** assignMe=NULL ) 
-		: ParamBinderBase( paramNum, assignMe )
+		: ParamBinderBase( paramNum, assignMe ), m_packed( false )
 	{
 	}
-	// what we actually produce
-	typedef std::vector< element_object_type > object_type;
 
 protected:
 
 	void doBind( const ObjectLoader & loader, expr_cref expr )
 	{
+		m_packed = loader.toLiteralVector( expr, m_literals );
+		if( m_packed )
+		{
+			return;
+		}
+
 		std::vector< RecursiveExpressionPtr > elements;
 		loader.toVector( expr, elements );
 
@@ -266,8 +330,23 @@ protected:
 	}
 
 public:
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		bool known = true;
+		for( size_t i = 0; i < m_elementBinders.size() && known; ++i )
+		{
+			known = m_elementBinders[i].dependencies( deps );
+		}
+		return known;
+	}
+
 	object_type obj() const
 	{
+		if( m_packed )
+		{
+			return m_literals;
+		}
+
 		object_type res;
 		try
 		{
@@ -282,6 +361,35 @@ public:
 		}
 		return res;
 	}
+
+	// how many elements it was bound to
+	size_t size() const
+	{
+		return m_packed ? m_literals.size() : m_elementBinders.size();
+	}
+
+	object_type take()
+	{
+		if( m_packed )
+		{
+			return std::move( m_literals );
+		}
+
+		object_type res;
+		res.reserve( m_elementBinders.size() );
+		try
+		{
+			for( element_binder_type & binder : m_elementBinders )
+			{
+				res.push_back( binder.take() );
+			}
+		}
+		catch( std::exception const& err )
+		{
+			handleError( err, "List" ); 
+		}
+		return res;
+	}
 };
 
 
@@ -291,9 +399,27 @@ template < typename T > struct binder_traits< std::vector<T> >
 };
 
 
-// Set: Type can only literal and must be unique
+// the hashed containers are sized for what goes in them before it does
+template< typename CONTAINER >
+void reserveFor( CONTAINER &, size_t )
+{
+}
 
-template< typename T >
+template< typename T, typename H, typename E, typename A >
+void reserveFor( std::unordered_set< T, H, E, A > & container, size_t size )
+{
+	container.reserve( size );
+}
+
+template< typename K, typename V, typename H, typename E, typename A >
+void reserveFor( std::unordered_map< K, V, H, E, A > & container, size_t size )
+{
+	container.reserve( size );
+}
+
+// Set: Type can only literal and must be unique. SET is std::set or std::unordered_set
+
+template< typename T, template< typename... > class SET = std::set >
 class SetParamBinder : public ParamBinderBase
 {
 	typedef T element_type;
@@ -302,10 +428,10 @@ class SetParamBinder : public ParamBinderBase
 	typedef LitParamBinder<T> element_binder_type;
 
 	std::vector< element_binder_type > m_elementBinders;
-	std::set< element_type > m_set;
+	SET< element_type > m_set;
 
 public:
-	typedef std::set< element_type > object_type;
+	typedef SET< element_type > object_type;
 	SetParamBinder( size_t paramNum = 0, ParamBinderBase** assignMe=NULL )
 		: ParamBinderBase( paramNum, assignMe )
 	{
@@ -315,6 +441,7 @@ protected:
 	{
 		std::vector< RecursiveExpressionPtr > elements;
 		loader.toVector( expr, elements );
+		reserveFor( m_set, elements.size() );
 
 		for( size_t i = 0; i < elements.size(); ++i )
 		{
@@ -330,10 +457,20 @@ protected:
 	}
 
 public:
+	bool dependencies( std::vector< const Builder * > & ) const
+	{
+		return true;
+	}
+
 	object_type obj() const
 	{
 		return m_set;
 	}
+
+	object_type take()
+	{
+		return std::move( m_set );
+	}
 };
 
 template< typename T > struct binder_traits< std::set<T > >
@@ -341,8 +478,13 @@ template< typename T > struct binder_traits< std::set<T > >
 	typedef SetParamBinder<T> binder_type;
 };
 
-// do the Map one next.
-template< typename K, typename V >
+template< typename T > struct binder_traits< std::unordered_set< T > >
+{
+	typedef SetParamBinder< T, std::unordered_set > binder_type;
+};
+
+// do the Map one next. MAP is std::map or std::unordered_map
+template< typename K, typename V, template< typename... > class MAP = std::map >
 class MapParamBinder : public ParamBinderBase
 {
 	typedef K key_type;
@@ -356,11 +498,11 @@ class MapParamBinder : public ParamBinderBase
     typedef ParameterBinder<V> value_binder_type;
 	typedef typename ParameterBinder<V>::object_type value_object_type;
 	
-	typedef std::map< key_type, value_binder_type > binder_map_type;
+	typedef MAP< key_type, value_binder_type > binder_map_type;
 	binder_map_type m_valueBinders;
 
 public:
-	typedef std::map< key_type, value_object_type > object_type;
+	typedef MAP< key_type, value_object_type > object_type;
 	MapParamBinder( size_t paramNum = 0, ParamBinderBase** assignMe=NULL ) 
 		: ParamBinderBase( paramNum, assignMe )
 	{
@@ -370,6 +512,7 @@ protected:
 	{
 		std::vector< std::pair< RecursiveExpressionPtr, RecursiveExpressionPtr > > pairs;
 		loader.toMap( expr, pairs );
+		reserveFor( m_valueBinders, pairs.size() );
 		
 		for( size_t i = 0; i < pairs.size(); ++i )
 		{
@@ -400,9 +543,21 @@ protected:
 	};
 */
 public:
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		bool known = true;
+		for( typename binder_map_type::const_iterator iter = m_valueBinders.begin();
+			iter != m_valueBinders.end() && known; ++iter )
+		{
+			known = iter->second.dependencies( deps );
+		}
+		return known;
+	}
+
 	object_type obj() const
 	{
 		object_type res;
+		reserveFor( res, m_valueBinders.size() );
 
 		try
 		{
@@ -420,6 +575,28 @@ public:
 
 		return res;
 	}
+
+	// each entry is taken out of here as it is moved across, keys and all
+	object_type take()
+	{
+		object_type res;
+		reserveFor( res, m_valueBinders.size() );
+
+		try
+		{
+			while( !m_valueBinders.empty() )
+			{
+				typename binder_map_type::node_type node = m_valueBinders.extract( m_valueBinders.begin() );
+				res.emplace_hint( res.end(), std::move( node.key() ), node.mapped().take() );
+			}
+		}
+		catch( std::exception const& err )
+		{
+			handleError( err, "Map" );
+		}
+
+		return res;
+	}
 };
 
 template< typename K, typename V > struct binder_traits< std::map< K, V > >
@@ -427,6 +604,11 @@ template< typename K, typename V > struct binder_traits< std::map< K, V > >
 	typedef MapParamBinder< K, V > binder_type;
 };
 
+template< typename K, typename V > struct binder_traits< std::unordered_map< K, V > >
+{
+	typedef MapParamBinder< K, V, std::unordered_map > binder_type;
+};
+
 // do the MultiMap one next. A lot of copy-pasted code from Map so consider refactor
 template< typename K, typename V >
 class MultiMapParamBinder : public ParamBinderBase
@@ -477,6 +659,17 @@ protected:
 	};
 */
 public:
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		bool known = true;
+		for( typename binder_map_type::const_iterator iter = m_valueBinders.begin();
+			iter != m_valueBinders.end() && known; ++iter )
+		{
+			known = iter->second.dependencies( deps );
+		}
+		return known;
+	}
+
 	object_type obj() const
 	{
 		object_type res;
@@ -497,6 +690,27 @@ public:
 
 		return res;
 	}
+
+	// each entry is taken out of here as it is moved across, keys and all
+	object_type take()
+	{
+		object_type res;
+
+		try
+		{
+			while( !m_valueBinders.empty() )
+			{
+				typename binder_map_type::node_type node = m_valueBinders.extract( m_valueBinders.begin() );
+				res.emplace_hint( res.end(), std::move( node.key() ), node.mapped().take() );
+			}
+		}
+		catch( std::exception const& err )
+		{
+			handleError( err, "Map" );
+		}
+
+		return res;
+	}
 };
 
 template< typename K, typename V > struct binder_traits< std::multimap< K, V > >
@@ -504,6 +718,298 @@ template< typename K, typename V > struct binder_traits< std::multimap< K, V > >
 	typedef MultiMapParamBinder< K, V > binder_type;
 };
 
+// The positions of the values in sorted order, which is how the flat containers are filled.
+// A repeated value is reported as a set or map would have, the first repeat as written.
+template< typename T >
+std::vector< size_t > sortedPositions( std::vector< T > const& values, const char * duplicate )
+{
+	std::vector< size_t > order( values.size() );
+	for( size_t i = 0; i < order.size(); ++i )
+	{
+		order[i] = i;
+	}
+
+	// equal values stay in the order they were written
+	std::sort( order.begin(), order.end(),
+		[&values]( size_t lhs, size_t rhs )
+		{
+			return values[lhs] < values[rhs] || ( !( values[rhs] < values[lhs] ) && lhs < rhs );
+		} );
+
+	size_t repeat = values.size();
+	for( size_t i = 1; i < order.size(); ++i )
+	{
+		if( !( values[ order[i-1] ] < values[ order[i] ] ) && order[i] < repeat )
+		{
+			repeat = order[i];
+		}
+	}
+
+	if( repeat < values.size() )
+	{
+		std::ostringstream oss;
+		oss << duplicate << values[repeat];
+		throw std::invalid_argument( oss.str() );
+	}
+	return order;
+}
+
+// boost::container::flat_set: sorted once it has all its values, rather than inserted into
+template< typename T >
+class FlatSetParamBinder : public ParamBinderBase
+{
+	typedef T element_type;
+	typedef LitParamBinder<T> element_binder_type;
+
+public:
+	typedef boost::container::flat_set< element_type > object_type;
+
+private:
+	object_type m_set;
+
+public:
+	FlatSetParamBinder( size_t paramNum = 0, ParamBinderBase** assignMe=NULL )
+		: ParamBinderBase( paramNum, assignMe )
+	{
+	}
+
+	static object_type fromValues( std::vector< element_type > && values )
+	{
+		std::vector< size_t > order = sortedPositions( values, "Duplicate value " );
+
+		object_type res;
+		res.reserve( values.size() );
+		for( size_t pos : order )
+		{
+			res.emplace_hint( res.end(), std::move( values[pos] ) );
+		}
+		return res;
+	}
+
+protected:
+	void doBind( const ObjectLoader & loader, expr_cref expr )
+	{
+		std::vector< RecursiveExpressionPtr > elements;
+		loader.toVector( expr, elements );
+
+		std::vector< element_type > values;
+		values.reserve( elements.size() );
+		for( size_t i = 0; i < elements.size(); ++i )
+		{
+			element_binder_type binder( i+1 );
+			binder.bind( loader, *elements[i] );
+			values.push_back( binder.take() );
+		}
+		m_set = fromValues( std::move( values ) );
+	}
+
+public:
+	bool dependencies( std::vector< const Builder * > & ) const
+	{
+		return true;
+	}
+
+	object_type obj() const
+	{
+		return m_set;
+	}
+
+	object_type take()
+	{
+		return std::move( m_set );
+	}
+};
+
+template< typename T > struct binder_traits< boost::container::flat_set< T > >
+{
+	typedef FlatSetParamBinder< T > binder_type;
+};
+
+// boost::container::flat_map: the keys are sorted once they are all bound and the values are
+// kept in that order, so it is filled from the front
+template< typename K, typename V >
+class FlatMapParamBinder : public ParamBinderBase
+{
+	typedef K key_type;
+	typedef V value_type;
+
+	typedef LitParamBinder<K> key_binder_type;
+	typedef ParameterBinder<V> value_binder_type;
+	typedef typename ParameterBinder<V>::object_type value_object_type;
+
+	typedef std::vector< std::pair< key_type, value_binder_type > > binder_vec_type;
+	binder_vec_type m_valueBinders; // sorted by key
+
+public:
+	typedef boost::container::flat_map< key_type, value_object_type > object_type;
+
+	FlatMapParamBinder( size_t paramNum = 0, ParamBinderBase** assignMe=NULL )
+		: ParamBinderBase( paramNum, assignMe )
+	{
+	}
+
+	static object_type fromEntries( std::vector< key_type > && keys, std::vector< value_object_type > && values )
+	{
+		std::vector< size_t > order = sortedPositions( keys, "Duplicate key " );
+
+		object_type res;
+		res.reserve( keys.size() );
+		for( size_t pos : order )
+		{
+			res.emplace_hint( res.end(), std::move( keys[pos] ), std::move( values[pos] ) );
+		}
+		return res;
+	}
+
+protected:
+	void doBind( const ObjectLoader & loader, expr_cref expr )
+	{
+		std::vector< std::pair< RecursiveExpressionPtr, RecursiveExpressionPtr > > pairs;
+		loader.toMap( expr, pairs );
+
+		std::vector< key_type > keys;
+		std::vector< value_binder_type > valueBinders;
+		keys.reserve( pairs.size() );
+		valueBinders.reserve( pairs.size() );
+		for( size_t i = 0; i < pairs.size(); ++i )
+		{
+			key_binder_type keyBinder( i+ 1 ); // 1 base is used here for error purposes
+			value_binder_type valueBinder( i + 1 );
+			keyBinder.bind( loader, *pairs[i].first );
+			valueBinder.bind( loader, *pairs[i].second );
+			keys.push_back( keyBinder.take() );
+			valueBinders.push_back( valueBinder );
+		}
+
+		std::vector< size_t > order = sortedPositions( keys, "Duplicate key " );
+		m_valueBinders.reserve( order.size() );
+		for( size_t pos : order )
+		{
+			m_valueBinders.push_back( typename binder_vec_type::value_type( std::move( keys[pos] ), valueBinders[pos] ) );
+		}
+	}
+
+public:
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		bool known = true;
+		for( size_t i = 0; i < m_valueBinders.size() && known; ++i )
+		{
+			known = m_valueBinders[i].second.dependencies( deps );
+		}
+		return known;
+	}
+
+	object_type obj() const
+	{
+		object_type res;
+		res.reserve( m_valueBinders.size() );
+
+		try
+		{
+			for( typename binder_vec_type::const_reference entry : m_valueBinders )
+			{
+				res.emplace_hint( res.end(), entry.first, entry.second.obj() );
+			}
+		}
+		catch( std::exception const& err )
+		{
+			handleError( err, "Map" );
+		}
+
+		return res;
+	}
+
+	object_type take()
+	{
+		object_type res;
+		res.reserve( m_valueBinders.size() );
+
+		try
+		{
+			for( typename binder_vec_type::reference entry : m_valueBinders )
+			{
+				res.emplace_hint( res.end(), std::move( entry.first ), entry.second.take() );
+			}
+		}
+		catch( std::exception const& err )
+		{
+			handleError( err, "Map" );
+		}
+
+		return res;
+	}
+};
+
+template< typename K, typename V > struct binder_traits< boost::container::flat_map< K, V > >
+{
+	typedef FlatMapParamBinder< K, V > binder_type;
+};
+
+// std::array, given as a List of exactly N elements
+template< typename T, size_t N >
+class ArrayParamBinder : public ParamBinderBase
+{
+	typedef VecParamBinder< T > list_binder_type;
+	typedef typename list_binder_type::object_type list_type;
+
+	list_binder_type m_list;
+
+public:
+	typedef std::array< typename list_type::value_type, N > object_type;
+
+	ArrayParamBinder( size_t paramNum = 0, ParamBinderBase** assignMe=NULL )
+		: ParamBinderBase( paramNum, assignMe )
+	{
+	}
+
+	static void checkSize( size_t size )
+	{
+		if( size != N )
+		{
+			std::ostringstream oss;
+			oss << "List of " << size << " elements given for an array of " << N;
+			throw std::invalid_argument( oss.str() );
+		}
+	}
+
+	static object_type fromList( list_type && list )
+	{
+		checkSize( list.size() );
+		object_type res = object_type();
+		std::move( list.begin(), list.end(), res.begin() );
+		return res;
+	}
+
+protected:
+	void doBind( const ObjectLoader & loader, expr_cref expr )
+	{
+		m_list.bind( loader, expr );
+		checkSize( m_list.size() );
+	}
+
+public:
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		return m_list.dependencies( deps );
+	}
+
+	object_type obj() const
+	{
+		return fromList( m_list.obj() );
+	}
+
+	object_type take()
+	{
+		return fromList( m_list.take() );
+	}
+};
+
+template< typename T, size_t N > struct binder_traits< std::array< T, N > >
+{
+	typedef ArrayParamBinder< T, N > binder_type;
+};
+
 
 // RefParamBinder. This is meant for structs or other objects that are to be
 // passed as parameters by reference. The object receiving them is expected
@@ -564,6 +1070,12 @@ public:
 		builder_cast( param, m_builder );
 	}
 
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		deps.push_back( m_builder.get() );
+		return true;
+	}
+
 	object_type const& obj() const
 	{
 		try
@@ -577,6 +1089,11 @@ public:
 			throw; // as above just to prevent "not all paths return a value" warning
 		}
 	}
+
+	object_type const& take()
+	{
+		return obj();
+	}
 };
 
 // this class is a dummy just to put in a parameter list
@@ -674,6 +1191,12 @@ public:
 		builder_cast( param, m_builder );
 	}
 
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		deps.push_back( m_builder.get() );
+		return true;
+	}
+
 	object_type obj() const
 	{
 		try
@@ -686,6 +1209,12 @@ public:
 			throw; // as above just to prevent "not all paths return a value" warning
 		}
 	}
+
+	// the proxy is shared so its value is copied
+	object_type take()
+	{
+		return obj();
+	}
 };
 
 // Note: it will not "smart-pointer" TYPE for you. Because TYPE will often not be smart-pointered.
@@ -754,7 +1283,7 @@ protected:
 				// complicated so use SetParamBinder
 				SetParamBinder<size_t> binder( m_paramNum );
 				binder.bind( loader, underlying );
-				std::set< size_t > obj = binder.obj();
+				std::set< size_t > obj = binder.take();
 				for( size_t idx : obj )
 				{
 					m_bitset.set( idx );
@@ -786,10 +1315,21 @@ protected:
 
 public:
 
+	// anything it was made from was used when it was bound
+	bool dependencies( std::vector< const Builder * > & ) const
+	{
+		return true;
+	}
+
 	object_type obj() const
 	{
 		return m_bitset;
 	}
+
+	object_type take()
+	{
+		return m_bitset;
+	}
 };
 
 template< size_t N >
@@ -848,11 +1388,43 @@ protected:
 	}
 
 public:
+	// as bind() but calls our doBind() directly. BuilderParams holds us by value so uses this
+	void bindParam( const ObjectLoader & loader, expr_cref expr )
+	{
+		try
+		{
+			ParameterBinder::doBind( loader, expr );
+		}
+		catch( TypeError const& )
+		{
+		    throw;
+		}
+		catch( std::exception const& err )
+		{
+			handleBindError( err, expr );
+		}
+	}
+
+	bool dependencies( std::vector< const Builder * > & deps ) const
+	{
+		return usingProxy ? proxy_binder.dependencies( deps ) : binder.dependencies( deps );
+	}
+
 	// get the object from whichever object we used
 	object_type obj() const
 	{
 		return usingProxy ? proxy_binder.obj()->get() : binder.obj();
 	}
+
+	// as obj() but moves out what the binder holds
+	object_type take()
+	{
+		if( usingProxy )
+		{
+			return proxy_binder.obj()->get();
+		}
+		return binder.take();
+	}
 };
 
 }
@@ -24,6 +24,9 @@ public:
 	// get the expression from a name. Throws if not found
 	virtual expr_cref lookup( str_cref name ) const = 0;
 
+	// every name the config defines, in no particular order
+	virtual void definitions( std::vector< std::string > & names ) const = 0;
+
 	// This is always returned as a vector of strings. If they are objects, you then
 	// need to resolve the objects. If you want numbers they must be lexically cast.
 
@@ -49,6 +52,21 @@ public:
 	virtual void toVector( expr_cref value, std::vector< RecursiveExpressionPtr > & res ) const = 0;
 	// after which w convert each expression returned
 
+	// A List of literals may have been packed by the parser, in which case these convert
+	// it in one go. They return false if it was not, or if any element does not convert,
+	// and it must then be converted an element at a time as above.
+	virtual bool toLiteralVector( expr_cref value, std::vector< double > & res ) const = 0;
+	virtual bool toLiteralVector( expr_cref value, std::vector< int > & res ) const = 0;
+	virtual bool toLiteralVector( expr_cref value, std::vector< size_t > & res ) const = 0;
+	virtual bool toLiteralVector( expr_cref value, std::vector< std::string > & res ) const = 0;
+
+	// no other element type is packed
+	template< typename T >
+	bool toLiteralVector( expr_cref, std::vector< T > & ) const
+	{
+		return false;
+	}
+
 	// to convert to a map we have to go through this...
 	virtual void toMap( expr_cref value, 
 		std::vector< std::pair< RecursiveExpressionPtr, RecursiveExpressionPtr > > & res ) const = 0;
@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef IOC_PROFILING_H_
+#define IOC_PROFILING_H_
+
+#include "../iocfwd.h"
+#include "../ioc_api.h"
+#include <cstddef>
+
+namespace IOC { namespace detail {
+
+enum ProfilePhase
+{
+	EParsePhase,		// loading a config file, or parsing a value of one loaded lazily
+	ELibraryLoadPhase,	// opening a library
+	ESymbolLookupPhase,	// finding a class in a library
+	EBindPhase,			// binding the parameters of a builder
+	EConstructPhase		// creating the object of a builder
+};
+
+// Times whatever is done while it is in scope, if profiling is enabled. Anything timed
+// while it is open, on the same thread, is counted as part of it.
+
+class IOC_API ProfileScope
+{
+	size_t m_event;
+
+	ProfileScope( ProfileScope const& ); // not implemented
+	ProfileScope & operator=( ProfileScope const& ); // not implemented
+
+	static size_t begin( ProfilePhase phase, str_cref name, const Builder * builder );
+	static void end( size_t event );
+
+public:
+	static const size_t npos = static_cast< size_t >( -1 );
+
+	ProfileScope( ProfilePhase phase, str_cref name )
+		: m_event( profiling() ? begin( phase, name, NULL ) : npos )
+	{
+	}
+
+	// named by its alias, or its type if it has none. One being constructed is linked to
+	// those it depends on to find the critical path
+	ProfileScope( ProfilePhase phase, Builder const& builder )
+		: m_event( profiling() ? begin( phase, std::string(), &builder ) : npos )
+	{
+	}
+
+	~ProfileScope()
+	{
+		if( m_event != npos )
+		{
+			end( m_event );
+		}
+	}
+
+	static bool profiling();
+};
+
+} }
+
+#endif
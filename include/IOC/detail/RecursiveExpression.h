@@ -6,8 +6,15 @@
 #include "../ioc_api.h"
 #include "../ioc_enum.h"
 #include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <iterator>
+#include <cstddef>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include <cstdint>
 
 namespace IOC {
 
@@ -18,29 +25,198 @@ namespace IOC {
 #pragma warning ( disable : 4275 )
 #endif
 
+class ExpressionArena;
+namespace detail { class SymbolTable; }
+
 /* 
  This class is an integral part of the IOC system, although it will not be used
   "directly" by programmers.
 */
 
+// The parameters of an expression are stored next to each other. This is a view of
+// them. Elements are handed out as RecursiveExpressionPtr as they were when this was
+// a std::vector, which it still converts to. Use at() to get a plain reference
+// without touching any reference count.
+
+class IOC_API ExpressionSpan
+{
+	const RecursiveExpression * m_begin;
+	size_t m_size;
+	ExpressionArena * m_arena;
+
+public:
+	class const_iterator
+	{
+		const RecursiveExpression * m_pos;
+		ExpressionArena * m_arena;
+
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef RecursiveExpressionPtr value_type;
+		typedef RecursiveExpressionPtr reference;
+		typedef void pointer;
+		typedef std::ptrdiff_t difference_type;
+
+		const_iterator( const RecursiveExpression * pos, ExpressionArena * arena )
+			: m_pos( pos ), m_arena( arena )
+		{
+		}
+
+		RecursiveExpressionPtr operator*() const;
+
+		const_iterator & operator++();
+		const_iterator operator++( int );
+
+		bool operator==( const_iterator const& other ) const
+		{
+			return m_pos == other.m_pos;
+		}
+
+		bool operator!=( const_iterator const& other ) const
+		{
+			return m_pos != other.m_pos;
+		}
+	};
+
+	typedef const_iterator iterator;
+
+	ExpressionSpan( const RecursiveExpression * begin, size_t size, ExpressionArena * arena )
+		: m_begin( begin ), m_size( size ), m_arena( arena )
+	{
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	// not bounds checked
+	RecursiveExpression const& at( size_t idx ) const;
+
+	RecursiveExpressionPtr operator[]( size_t idx ) const;
+
+	const_iterator begin() const
+	{
+		return const_iterator( m_begin, m_arena );
+	}
+
+	const_iterator end() const;
+
+	operator std::vector< RecursiveExpressionPtr >() const;
+};
+
+// The binary value of an EInt, EReal or EBool literal, decoded once when it is parsed
+union LiteralValue
+{
+	int64_t m_int;
+	double m_real;
+	bool m_bool;
+};
+
+// The elements of a List that are all literal ints, reals or strings, held together
+// rather than as one expression each. A long List like this is packed by the parser.
+// Each element keeps its text as well as its value so it can be reported as written.
+
+class IOC_API LiteralArray
+{
+	ExpressionType m_type;
+	std::vector< LiteralValue > m_values; // not for strings
+	std::string m_text;
+	std::vector< uint32_t > m_ends; // where the text of each element ends in m_text
+
+public:
+	// Lists with fewer elements than this are not worth packing
+	static const size_t minSize = 16;
+
+	explicit LiteralArray( ExpressionType type );
+
+	// false if there is too much text to add it
+	bool add( std::string_view text, LiteralValue value );
+
+	// decodes the value, false if it does not decode as the type
+	bool add( std::string_view text );
+
+	void shrink_to_fit();
+
+	// the same elements of the same type
+	bool operator==( LiteralArray const& other ) const;
+
+	// of the type and the text of every element, so equal arrays hash the same
+	size_t hash() const;
+
+	// of every element
+	ExpressionType type() const
+	{
+		return m_type;
+	}
+
+	size_t size() const
+	{
+		return m_ends.size();
+	}
+
+	std::string_view text( size_t idx ) const
+	{
+		size_t begin = idx ? m_ends[idx-1] : 0;
+		return std::string_view( m_text.data() + begin, m_ends[idx] - begin );
+	}
+
+	// not for strings
+	LiteralValue value( size_t idx ) const
+	{
+		return m_values[idx];
+	}
+};
+
 class IOC_API RecursiveExpression 
 {
 public:
+	// What a variable has been linked to by the loader of its config
+	enum LinkState
+	{
+		ENotLinked,
+		ELinked, // target is the expression the variable resolves to
+		EUndefinedLink, // target is the variable whose name is not defined
+		ECircularLink // no target, the name is where the chain starts to repeat
+	};
 	
 private:
-	friend class RecursiveExpressionParser;
+	friend class ExpressionArena;
 	typedef ExpressionType Type;
-	std::string m_value;
-	std::vector< RecursiveExpressionPtr > m_params;
 
-	Type m_type;
-	RecursiveExpression * m_parent;
+	// held by the arena. Names are interned so every use of one shares the string
+	const std::string * m_value;
 
-	void setError( std::string const& value );
+	// A variable has no parameters and once linked these hold its target and the
+	// name of the last variable on the way there instead. Literals have no parameters
+	// either and hold their decoded value here
+	union
+	{
+		const RecursiveExpression * m_params; // allocated in m_arena too
+		const RecursiveExpression * m_target;
+		LiteralValue m_literal;
+		const LiteralArray * m_elements; // for a packed List
+		const RecursiveExpression * m_original; // for a folded Concat
+	};
+	uint32_t m_numParams;
 
-	void addToParent();
+	uint8_t m_type;
+	uint8_t m_link;
+	bool m_packed;
+	bool m_folded;
 
-	RecursiveExpression( RecursiveExpression * parent, std::string const& value, Type type );
+	union
+	{
+		ExpressionArena * m_arena;
+		const std::string * m_targetName;
+	};
+
+	RecursiveExpression();
 
 public:
 	// types that we parsed in
@@ -48,36 +224,253 @@ public:
 	// Error means it failed parsing
 	
 
+	// creates an expression with no parameters, in an arena of its own
+	static RecursiveExpressionPtr create( std::string const& value, Type type );
+	static RecursiveExpressionPtr create();
 
-	// if created with non-NULL parent there is no need to manage its lifetime as its parent will
-	// If created with NULL parent you must manage its lifetime
-	static RecursiveExpression * create( RecursiveExpression * parent, std::string const& value, Type type );
-	static RecursiveExpression * create();
+	// the expression is allocated in the arena, which the result keeps alive.
+	// The arena must itself be held by a shared_ptr.
+	// The line is not referenced once parse returns so it can be a view into a larger buffer
+	static RecursiveExpressionPtr parse( std::string_view line, std::string const& currentDir,
+		ExpressionArena & arena );
 
-	static RecursiveExpressionPtr parse( std::string const& line, std::string const& currentDir );
+	// as above, in an arena of its own
+	static RecursiveExpressionPtr parse( std::string_view line, std::string const& currentDir );
 	
 	std::string const& value() const
 	{
-		return m_value;
+		return *m_value;
 	}
 
 	Type type() const
 	{
-		return m_type;
+		return static_cast< Type >( m_type );
 	}
 
-	std::vector< RecursiveExpressionPtr > const& params() const
+	ExpressionSpan params() const
 	{
-		return m_params;
+		return ExpressionSpan( m_params, m_numParams, m_arena );
 	}
 
 	// not bounds checked
 	RecursiveExpressionPtr param( size_t idx ) const
+	{
+		return params()[idx];
+	}
+
+	// not bounds checked
+	RecursiveExpression const& paramAt( size_t idx ) const
 	{
 		return m_params[idx];
 	}
+
+	// A Concat of constant strings is folded into the string it makes once loaded. It is then
+	// an EString and this is the Concat as it was written, for messages. NULL otherwise
+	const RecursiveExpression * foldedFrom() const
+	{
+		return m_folded ? m_original : NULL;
+	}
+
+	// Only for a Concat, which becomes an EString of this value. Folding anything
+	// else throws std::logic_error
+	void fold( std::string && value );
+
+	// Only for a List whose elements are packed, in which case it has no params
+	const LiteralArray * literals() const
+	{
+		return m_packed ? m_elements : NULL;
+	}
+
+	// valid only for an EInt, EReal and EBool respectively
+	int64_t intValue() const
+	{
+		return m_literal.m_int;
+	}
+
+	double realValue() const
+	{
+		return m_literal.m_real;
+	}
+
+	bool boolValue() const
+	{
+		return m_literal.m_bool;
+	}
+
+	// Only variables are linked. The name must outlive this expression.
+	// Linking anything else throws std::logic_error
+	void link( LinkState state, const RecursiveExpression * target, std::string const& name );
+
+	LinkState linkState() const
+	{
+		return static_cast< LinkState >( m_link );
+	}
+
+	// valid only if linked
+	RecursiveExpression const& target() const
+	{
+		return *m_target;
+	}
+
+	std::string const& targetName() const
+	{
+		return *m_targetName;
+	}
 };
 
+// Expressions parsed by the loader are allocated from here in blocks rather than
+// one by one, and the parameters of each expression are allocated together.
+// Everything in it lives as long as the arena, which every RecursiveExpressionPtr
+// into it shares ownership of. Names (variables, classes, functions) are interned as
+// the same few are used over and over. Literal values are mostly distinct and are not.
+//
+// Not thread-safe. Use one arena per thread when parsing concurrently.
+
+class IOC_API ExpressionArena : public spns::enable_shared_from_this< ExpressionArena >
+{
+	std::vector< RecursiveExpression * > m_blocks;
+	size_t m_blockUsed;
+	size_t m_blockCapacity;
+	size_t m_size;
+	std::unique_ptr< detail::SymbolTable > m_names;
+	std::deque< std::string > m_literals;
+	std::deque< LiteralArray > m_packed;
+
+	// Parameters laid out by parse, by structural hash, so an identical sub-tree parsed
+	// later can share them. Packed Lists are shared the same way
+	std::unordered_multimap< size_t, std::pair< const RecursiveExpression *, size_t > > m_shareable;
+	std::unordered_multimap< size_t, const LiteralArray * > m_shareableLiterals;
+	size_t m_numShared;
+	size_t m_sharedSize;
+
+	ExpressionArena( ExpressionArena const& ); // not copyable
+	ExpressionArena & operator=( ExpressionArena const& );
+
+	// value must be held by this arena
+	void link( RecursiveExpression & expr, std::string const& value, ExpressionType type,
+		const RecursiveExpression * params, size_t numParams );
+	void link( RecursiveExpression & expr, std::string const& value, ExpressionType type,
+		LiteralValue literal );
+
+public:
+	ExpressionArena();
+	~ExpressionArena();
+
+	// count contiguous expressions, empty until set
+	RecursiveExpression * allocate( size_t count );
+
+	void set( RecursiveExpression & expr, std::string_view value, ExpressionType type,
+		const RecursiveExpression * params, size_t numParams );
+	void set( RecursiveExpression & expr, std::string && value, ExpressionType type,
+		const RecursiveExpression * params, size_t numParams );
+
+	// for an EInt, EReal or EBool whose value has already been decoded.
+	// The ones above decode it from value
+	void set( RecursiveExpression & expr, std::string && value, ExpressionType type,
+		LiteralValue literal );
+
+	// for a List whose elements are packed. If an identical List is already packed in this
+	// arena, its elements are shared
+	void set( RecursiveExpression & list, std::string_view value, LiteralArray && elements );
+
+	// the elements of a packed List as expressions, allocated together
+	RecursiveExpression * expand( LiteralArray const& elements );
+
+	// replaces a Concat in this arena with the string it makes, keeping a copy of it
+	void fold( RecursiveExpression & concat, std::string && value );
+
+	// Identical sub-trees are laid out once and their parameters shared, as nothing changes
+	// them once parsed except linking and folding, which would change each copy the same
+	// way. same() is called on each candidate with the same hash until one matches
+	template< typename Same >
+	const RecursiveExpression * findShared( size_t hash, size_t numParams, Same same ) const
+	{
+		typedef std::unordered_multimap< size_t, std::pair< const RecursiveExpression *, size_t > > map_type;
+		std::pair< map_type::const_iterator, map_type::const_iterator > range = m_shareable.equal_range( hash );
+		for( ; range.first != range.second; ++range.first )
+		{
+			if( range.first->second.second == numParams && same( range.first->second.first ) )
+			{
+				return range.first->second.first;
+			}
+		}
+		return NULL;
+	}
+
+	// params must have been laid out completely
+	void addShared( size_t hash, const RecursiveExpression * params, size_t numParams );
+
+	// counts a sub-tree of size expressions that shares one found already
+	void reuse( size_t size );
+
+	// once nothing more will be parsed into the arena
+	void clearShared();
+
+	// number of sub-trees that share one already in the arena
+	size_t numShared() const
+	{
+		return m_numShared;
+	}
+
+	// number of expressions that did not have to be allocated because of it
+	size_t sharedSize() const
+	{
+		return m_sharedSize;
+	}
+
+	// a pointer to an expression in this arena that keeps the arena alive
+	RecursiveExpressionPtr share( RecursiveExpression const * expr )
+	{
+		return RecursiveExpressionPtr( shared_from_this(), const_cast< RecursiveExpression * >( expr ) );
+	}
+
+	// number of expressions allocated
+	size_t size() const
+	{
+		return m_size;
+	}
+};
+
+// these need RecursiveExpression to be complete
+
+inline RecursiveExpressionPtr ExpressionSpan::const_iterator::operator*() const
+{
+	return m_arena->share( m_pos );
+}
+
+inline ExpressionSpan::const_iterator & ExpressionSpan::const_iterator::operator++()
+{
+	++m_pos;
+	return *this;
+}
+
+inline ExpressionSpan::const_iterator ExpressionSpan::const_iterator::operator++( int )
+{
+	const_iterator res( *this );
+	++m_pos;
+	return res;
+}
+
+inline RecursiveExpression const& ExpressionSpan::at( size_t idx ) const
+{
+	return m_begin[idx];
+}
+
+inline RecursiveExpressionPtr ExpressionSpan::operator[]( size_t idx ) const
+{
+	return m_arena->share( m_begin + idx );
+}
+
+inline ExpressionSpan::const_iterator ExpressionSpan::end() const
+{
+	return const_iterator( m_begin + m_size, m_arena );
+}
+
+inline ExpressionSpan::operator std::vector< RecursiveExpressionPtr >() const
+{
+	return std::vector< RecursiveExpressionPtr >( begin(), end() );
+}
+
 }
 
 //extern template class IOC_API std::vector< IOC::RecursiveExpressionPtr >;
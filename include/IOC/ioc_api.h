@@ -4,6 +4,7 @@
 // Internal libraries will already define this 
 
 #include "iocfwd.h"
+#include <iosfwd>
 
 #if defined _WIN32 || defined _WIN64
 
@@ -41,6 +42,85 @@ namespace IOC {
 
 	ObjectLoaderPtr IOC_API getObjectLoader( str_cref filePath );
 
+	// getRunnable() normally loads the config afresh every time. With the loader cache
+	// enabled it keeps each config it loads, with every named object built from it, for
+	// later calls with the same file, so those objects are shared by all the runnables got
+	// from it. A config is loaded again once any file it came from has changed, or after a
+	// call fails. evictLoader() drops a config so the next call loads it again, and
+	// reloadLoader() loads it again now, keeping what there was if that fails. Disabling
+	// the cache drops everything. Calls to getRunnable() that use the same kept config bind
+	// their objects one at a time but construct them at the same time.
+
+	void IOC_API enableLoaderCache();
+	void IOC_API disableLoaderCache();
+	void IOC_API evictLoader( str_cref filePath );
+	void IOC_API reloadLoader( str_cref filePath );
+
+	// Parsed configs can be kept in a compiled form (.iocc) which is used instead
+	// of parsing again for as long as none of the files it came from has changed.
+	// With no directory the compiled file goes next to the config, e.g. foo.iocc.
+	// Like initIOCObjLibrary() call it before getRunnable().
+
+	void IOC_API enableConfigCache( str_cref cacheDir = std::string() );
+	void IOC_API disableConfigCache();
+
+	// How a loaded config is held in memory. ETreeLayout keeps the expressions as they
+	// were parsed. EFlatLayout also copies them into parallel arrays which are walked
+	// when converting Concat and Map values. It applies to configs loaded after it is set.
+
+	enum ConfigLayout { ETreeLayout, EFlatLayout };
+	void IOC_API setConfigLayout( ConfigLayout layout );
+
+	// When the values in a config are parsed. EEagerParse parses them all as the config is
+	// loaded, so a syntax error anywhere in it is reported then. ELazyParse only reads the
+	// statements, still checking every name, and parses a value the first time it is looked
+	// up, which is much quicker when only a small part of a large config is used. A config
+	// loaded lazily is not cached, and one in EFlatLayout is always parsed eagerly.
+	// It applies to configs loaded after it is set.
+
+	enum ConfigParsing { EEagerParse, ELazyParse };
+	void IOC_API setConfigParsing( ConfigParsing parsing );
+
+	// How many threads getRunnable() constructs objects on, 0 being one per core. With
+	// more than one, objects that do not depend on each other are constructed at the same
+	// time, so their constructors must be safe to call concurrently. The default of 1
+	// constructs everything on the calling thread as each object is first needed.
+
+	void IOC_API setConstructionThreads( size_t threads );
+
+	// When the libraries a config defines are opened. EOpenWhenUsed opens each the first
+	// time a class in it is needed. EOpenOnLoad starts opening all of them as soon as the
+	// config is loaded, on a pool of threads (0 being one per core), so that opening them
+	// overlaps with binding and constructing, and with each other where the platform allows
+	// it, logging how long each took. A library that fails is opened again when used so the
+	// error is reported as before. Either way a library written Library( path, [ A, B ] )
+	// is only opened after A and B, which it may need the symbols of.
+	// It applies to configs loaded after it is set.
+
+	enum LibraryOpening { EOpenWhenUsed, EOpenOnLoad };
+	void IOC_API setLibraryOpening( LibraryOpening opening, size_t threads = 0 );
+
+	// When the symbols a library uses are resolved. EBindWhenUsed resolves each as it is
+	// first called (RTLD_LAZY). EBindOnOpen resolves them all as the library is opened
+	// (RTLD_NOW), which is slower to open but reports any that are missing at once.
+
+	enum LibraryBinding { EBindWhenUsed, EBindOnOpen };
+	void IOC_API setLibraryBinding( LibraryBinding binding );
+
+	// Records how long is spent loading configs, opening libraries, finding classes in them,
+	// binding parameters and constructing each object, to find what makes startup slow.
+	// Enabling it discards anything recorded before.
+	// writeProfile() writes JSON with the time spent in each of those phases, the inclusive
+	// and exclusive time to bind and construct each object, slowest first, and the critical
+	// path: the chain of objects, each made from the next, whose constructors took longest
+	// in total. writeProfileTrace() writes every timing in the Chrome trace event format,
+	// for chrome://tracing or Perfetto.
+
+	void IOC_API enableProfiling();
+	void IOC_API disableProfiling();
+	void IOC_API writeProfile( std::ostream & os );
+	void IOC_API writeProfileTrace( std::ostream & os );
+
 }
 
 namespace Utility {
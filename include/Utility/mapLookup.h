@@ -12,10 +12,30 @@ namespace Utility {
 
 // Coll should be std::map or std::unordered_map but not multimap
 
+// The key need not be the key type of the map. It is looked up as it is if the map
+// can find it that way, e.g. a std::string_view in a map with std::less<>, and is
+// only converted to the key type if it cannot.
+
+namespace detail {
+
+template< typename Coll, typename K >
+auto mapFind( Coll const& map, const K& key, int ) -> decltype( map.find( key ) )
+{
+	return map.find( key );
+}
+
+template< typename Coll, typename K >
+typename Coll::const_iterator mapFind( Coll const& map, const K& key, long )
+{
+	return map.find( typename Coll::key_type( key ) );
+}
+
+}
+
 template< typename K, typename V, typename Coll >
 bool mapLookup( Coll const& map, const K& key, V& value )
 {
-	typename Coll::const_iterator iter = map.find(key);
+	typename Coll::const_iterator iter = detail::mapFind( map, key, 0 );
 	if( iter == map.end() )
 	{
 		return false;
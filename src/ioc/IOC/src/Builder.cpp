@@ -75,10 +75,16 @@ namespace IOC
 		}
 		catch( std::exception const& err )
 		{
-			handleError( err, expr.value() );
+			handleBindError( err, expr );
 		}
 	}
 
+	void ParamBinderBase::handleBindError( std::exception const& err, expr_cref expr ) const
+	{
+		// a folded Concat is reported as it was written
+		handleError( err, expr.foldedFrom() ? expr.foldedFrom()->value() : expr.value() );
+	}
+
 	void ParamBinderBase::handleError( std::exception const& err, str_cref variable ) const
 	{
 		std::ostringstream oss;
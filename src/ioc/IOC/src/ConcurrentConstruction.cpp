@@ -0,0 +1,236 @@
+#include "stdafx.h"
+
+#include "ConcurrentConstruction.h"
+#include <IOC/Builder.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace IOC { namespace detail {
+
+namespace {
+
+// The builders reachable from the root, numbered from 0, with the builders of the objects
+// made from each, which have to wait for it
+struct ConstructionGraph
+{
+	std::vector< const Builder * > m_builders;
+	std::vector< std::vector< size_t > > m_dependents;
+	std::vector< size_t > m_numDependencies;
+
+	// false if a builder does not know what it depends on
+	bool build( Builder const& root );
+};
+
+bool ConstructionGraph::build( Builder const& root )
+{
+	std::unordered_map< const Builder *, size_t > numbered;
+	numbered.insert( std::make_pair( &root, 0 ) );
+	m_builders.push_back( &root );
+	m_dependents.emplace_back();
+
+	std::vector< const Builder * > deps;
+	for( size_t idx = 0; idx < m_builders.size(); ++idx )
+	{
+		deps.clear();
+		if( !m_builders[idx]->dependencies( deps ) )
+		{
+			return false;
+		}
+
+		m_numDependencies.push_back( deps.size() );
+		for( const Builder * dep : deps )
+		{
+			std::pair< std::unordered_map< const Builder *, size_t >::iterator, bool > res =
+				numbered.insert( std::make_pair( dep, m_builders.size() ) );
+			if( res.second )
+			{
+				m_builders.push_back( dep );
+				m_dependents.emplace_back();
+			}
+			m_dependents[ res.first->second ].push_back( idx );
+		}
+	}
+	return true;
+}
+
+// Each worker takes the builders that are ready from the back of its own queue, where it
+// puts those it makes ready, so it tends to carry on up the same branch. A worker with
+// nothing to do steals from the front of another's.
+class ConstructionPool
+{
+	struct Queue
+	{
+		std::mutex m_lock;
+		std::deque< size_t > m_ready;
+	};
+
+	ConstructionGraph const& m_graph;
+	std::unique_ptr< std::atomic< size_t >[] > m_waitingFor;
+	std::deque< Queue > m_queues;
+
+	std::atomic< size_t > m_numReady;
+	std::atomic< size_t > m_outstanding; // ready or being constructed
+	std::atomic< bool > m_failed;
+	std::mutex m_idleLock;
+	std::condition_variable m_idle;
+
+public:
+	ConstructionPool( ConstructionGraph const& graph, size_t numWorkers )
+		: m_graph( graph ), m_waitingFor( new std::atomic< size_t >[ graph.m_builders.size() ] ),
+		m_queues( numWorkers ), m_numReady( 0 ), m_outstanding( 0 ), m_failed( false )
+	{
+		for( size_t idx = 0; idx < graph.m_builders.size(); ++idx )
+		{
+			m_waitingFor[idx] = graph.m_numDependencies[idx];
+			if( !graph.m_numDependencies[idx] )
+			{
+				++m_outstanding;
+				push( idx % numWorkers, idx );
+			}
+		}
+	}
+
+	void work( size_t worker );
+
+private:
+	void push( size_t worker, size_t idx );
+	bool take( size_t worker, size_t & idx );
+	void construct( size_t worker, size_t idx );
+};
+
+void ConstructionPool::push( size_t worker, size_t idx )
+{
+	{
+		std::lock_guard< std::mutex > lock( m_queues[worker].m_lock );
+		m_queues[worker].m_ready.push_back( idx );
+	}
+	++m_numReady;
+
+	std::lock_guard< std::mutex > lock( m_idleLock );
+	m_idle.notify_one();
+}
+
+bool ConstructionPool::take( size_t worker, size_t & idx )
+{
+	for( size_t i = 0; i < m_queues.size(); ++i )
+	{
+		Queue & queue = m_queues[ ( worker + i ) % m_queues.size() ];
+		std::lock_guard< std::mutex > lock( queue.m_lock );
+		if( !queue.m_ready.empty() )
+		{
+			if( i == 0 )
+			{
+				idx = queue.m_ready.back();
+				queue.m_ready.pop_back();
+			}
+			else
+			{
+				idx = queue.m_ready.front();
+				queue.m_ready.pop_front();
+			}
+			--m_numReady;
+			return true;
+		}
+	}
+	return false;
+}
+
+// once anything has failed nothing more is constructed, getObject() will report it
+void ConstructionPool::construct( size_t worker, size_t idx )
+{
+	if( !m_failed )
+	{
+		try
+		{
+			m_graph.m_builders[idx]->construct();
+			for( size_t dependent : m_graph.m_dependents[idx] )
+			{
+				if( --m_waitingFor[dependent] == 0 )
+				{
+					++m_outstanding;
+					push( worker, dependent );
+				}
+			}
+		}
+		catch( ... )
+		{
+			m_failed = true;
+		}
+	}
+
+	if( --m_outstanding == 0 )
+	{
+		std::lock_guard< std::mutex > lock( m_idleLock );
+		m_idle.notify_all();
+	}
+}
+
+// Anything in a circular reference never becomes ready, so the work is done when nothing
+// is ready or being constructed
+void ConstructionPool::work( size_t worker )
+{
+	while( true )
+	{
+		size_t idx;
+		if( take( worker, idx ) )
+		{
+			construct( worker, idx );
+			continue;
+		}
+
+		std::unique_lock< std::mutex > lock( m_idleLock );
+		if( m_outstanding == 0 )
+		{
+			return;
+		}
+		m_idle.wait( lock, [ this ]{ return m_numReady != 0 || m_outstanding == 0; } );
+	}
+}
+
+}
+
+void constructConcurrently( Builder const& root, size_t threads )
+{
+	ConstructionGraph graph;
+	if( !graph.build( root ) || graph.m_builders.size() < 2 )
+	{
+		return;
+	}
+
+	if( !threads )
+	{
+		threads = std::max( 1u, std::thread::hardware_concurrency() );
+	}
+	threads = std::min( threads, graph.m_builders.size() );
+
+	// Workers steal what the others have not got to, so if one cannot be started the rest,
+	// including this thread, construct what it would have
+	ConstructionPool pool( graph, threads );
+	std::vector< std::thread > workers;
+	for( size_t worker = 1; worker < threads; ++worker )
+	{
+		try
+		{
+			workers.emplace_back( [ &pool, worker ]{ pool.work( worker ); } );
+		}
+		catch( std::system_error const& )
+		{
+			break;
+		}
+	}
+	pool.work( 0 );
+	for( std::thread & worker : workers )
+	{
+		worker.join();
+	}
+}
+
+} }
@@ -0,0 +1,24 @@
+#pragma once
+
+#ifndef IOC_CONCURRENT_CONSTRUCTION_H_
+#define IOC_CONCURRENT_CONSTRUCTION_H_
+
+#include <IOC/iocfwd.h>
+#include <cstddef>
+
+namespace IOC { namespace detail {
+
+// Constructs the object of a bound builder and everything it is made from on a pool of
+// threads, 0 being one per core. Each object is constructed once everything it is made
+// from has been, so those that do not depend on each other are constructed at the same
+// time. If any builder cannot say what it depends on, nothing is constructed here.
+//
+// Nothing is thrown. An object that fails, or is part of a circular reference, is left
+// unconstructed along with everything made from it, so that getObject() on the root then
+// reports the error as it always did.
+
+void constructConcurrently( Builder const& root, size_t threads );
+
+} }
+
+#endif
@@ -0,0 +1,551 @@
+#include "stdafx.h"
+
+#include "ConfigCache.h"
+#include "MappedFile.h"
+#include <IOC/ioc_api.h>
+#include <IOC/detail/RecursiveExpression.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+
+namespace {
+
+// Layout of a compiled config. All numbers are native-endian, a cache is not
+// meant to be moved between machines. The magic number catches that anyway.
+//
+//   header:  magic, version, body size, string pool size
+//   body:    config path
+//            file count, then for each file: path, mtime, size, content hash, recent
+//            define count, then for each: name, value
+//            entry count, then for each: key, index of its root node
+//            node count, then for each: type, value, first child, child count
+//   pool:    the text of every string above, referenced as offset and length
+//
+// The children of a node are always contiguous and after it, so loading is just
+// one pass over the nodes fixing up indexes into parent pointers.
+
+const uint32_t cacheMagic = 0x43434f49; // IOCC
+const uint32_t cacheVersion = 2;
+
+// The coarsest file times we expect: FAT keeps them to 2 seconds. A file modified within
+// this of being stamped could be modified again without its time changing.
+const std::chrono::seconds fileTimeGranularity( 2 );
+
+struct CacheSettings
+{
+	bool enabled = false;
+	std::string directory; // empty means next to the config file
+};
+
+CacheSettings & cacheSettings()
+{
+	// like the library table this is set up whilst we are single threaded
+	static CacheSettings settings;
+	return settings;
+}
+
+// FNV-1a. We only need to know if a file has changed, not to guard against attack
+uint64_t hashText( std::string_view text, uint64_t hash = 14695981039346656037ULL )
+{
+	for( char ch : text )
+	{
+		hash ^= static_cast< unsigned char >( ch );
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+}
+
+namespace IOC { namespace detail {
+
+// boost::filesystem only gives the time to the second, so it is taken from std::filesystem
+bool stampTime( str_cref path, FileStamp & stamp )
+{
+	typedef std::filesystem::file_time_type file_time;
+
+	stamp.recent = true;
+	std::error_code err;
+	file_time mtime = std::filesystem::last_write_time( path, err );
+	if( err )
+	{
+		return false;
+	}
+	stamp.mtime = std::chrono::duration_cast< std::chrono::nanoseconds >( mtime.time_since_epoch() ).count();
+	stamp.recent = file_time::clock::now() - mtime < fileTimeGranularity;
+	return true;
+}
+
+void stampText( std::string_view text, FileStamp & stamp )
+{
+	stamp.size = text.size();
+	stamp.hash = hashText( text );
+}
+
+bool stampFile( str_cref path, FileStamp & stamp, bool withHash )
+{
+	if( !stampTime( path, stamp ) )
+	{
+		return false;
+	}
+
+	stamp.hash = 0;
+	if( withHash )
+	{
+		IOC::detail::MappedFile file;
+		if( !file.open( path ) )
+		{
+			return false;
+		}
+		stampText( file.text(), stamp );
+	}
+	else
+	{
+		boost::system::error_code err;
+		stamp.size = boost::filesystem::file_size( path, err );
+		if( err )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool unchanged( str_cref path, FileStamp const& stamp )
+{
+	FileStamp current;
+	if( !stampFile( path, current, false ) || current.size != stamp.size )
+	{
+		return false;
+	}
+	return ( current.mtime == stamp.mtime && !stamp.recent ) ||
+		( stampFile( path, current, true ) && current.hash == stamp.hash );
+}
+
+} }
+
+namespace {
+
+class CacheWriter
+{
+	std::string m_body;
+	std::string m_pool;
+
+public:
+	template< typename T > void put( T value )
+	{
+		m_body.append( reinterpret_cast< const char * >( &value ), sizeof( value ) );
+	}
+
+	void putString( std::string_view str )
+	{
+		put< uint64_t >( m_pool.size() );
+		put< uint64_t >( str.size() );
+		m_pool.append( str );
+	}
+
+	bool write( std::string const& path ) const
+	{
+		std::ofstream ofs( path.c_str(), std::ios::binary | std::ios::trunc );
+		uint32_t header[] = { cacheMagic, cacheVersion };
+		uint64_t sizes[] = { m_body.size(), m_pool.size() };
+		ofs.write( reinterpret_cast< const char * >( header ), sizeof( header ) );
+		ofs.write( reinterpret_cast< const char * >( sizes ), sizeof( sizes ) );
+		ofs.write( m_body.data(), m_body.size() );
+		ofs.write( m_pool.data(), m_pool.size() );
+		return static_cast< bool >( ofs.flush() );
+	}
+};
+
+// Everything read is bounds checked. Once anything is out of place the reader
+// goes bad and returns zeros from then on, and the cache is treated as stale.
+class CacheReader
+{
+	std::string_view m_body;
+	std::string_view m_pool;
+	size_t m_pos;
+	bool m_ok;
+
+public:
+	explicit CacheReader( std::string_view data )
+		: m_pos( 0 ), m_ok( false )
+	{
+		const size_t headerSize = 2 * sizeof( uint32_t ) + 2 * sizeof( uint64_t );
+		if( data.size() < headerSize )
+		{
+			return;
+		}
+
+		uint32_t header[2];
+		uint64_t sizes[2];
+		std::memcpy( header, data.data(), sizeof( header ) );
+		std::memcpy( sizes, data.data() + sizeof( header ), sizeof( sizes ) );
+		if( header[0] != cacheMagic || header[1] != cacheVersion ||
+			sizes[0] > data.size() - headerSize || sizes[1] != data.size() - headerSize - sizes[0] )
+		{
+			return;
+		}
+
+		m_body = data.substr( headerSize, sizes[0] );
+		m_pool = data.substr( headerSize + sizes[0] );
+		m_ok = true;
+	}
+
+	bool ok() const
+	{
+		return m_ok;
+	}
+
+	template< typename T > T get()
+	{
+		T value = T();
+		if( m_ok && m_body.size() - m_pos >= sizeof( value ) )
+		{
+			std::memcpy( &value, m_body.data() + m_pos, sizeof( value ) );
+			m_pos += sizeof( value );
+		}
+		else
+		{
+			m_ok = false;
+		}
+		return value;
+	}
+
+	std::string_view getString()
+	{
+		uint64_t offset = get< uint64_t >();
+		uint64_t length = get< uint64_t >();
+		if( !m_ok || offset > m_pool.size() || length > m_pool.size() - offset )
+		{
+			m_ok = false;
+			return std::string_view();
+		}
+		return m_pool.substr( offset, length );
+	}
+
+	// a count of records that must each take at least recordSize bytes of what remains
+	uint64_t getCount( size_t recordSize )
+	{
+		uint64_t count = get< uint64_t >();
+		if( m_ok && count > ( m_body.size() - m_pos ) / recordSize )
+		{
+			m_ok = false;
+			count = 0;
+		}
+		return count;
+	}
+};
+
+struct CacheNode
+{
+	IOC::ExpressionType type;
+	std::string_view value;
+	uint64_t firstChild;
+	uint64_t childCount;
+};
+
+// A List of enough literals of one type is packed, as the parser would have done.
+// Its elements are marked so they are not set up as well
+bool packList( CacheNode const& node, std::vector< CacheNode > const& nodes, std::vector< bool > & packed )
+{
+	if( node.type != IOC::EList || node.childCount < IOC::LiteralArray::minSize )
+	{
+		return false;
+	}
+
+	IOC::ExpressionType type = nodes[ node.firstChild ].type;
+	if( type != IOC::EInt && type != IOC::EReal && type != IOC::EString )
+	{
+		return false;
+	}
+	for( size_t child = node.firstChild; child != node.firstChild + node.childCount; ++child )
+	{
+		if( nodes[child].type != type || nodes[child].childCount != 0 )
+		{
+			return false;
+		}
+	}
+
+	std::fill( packed.begin() + node.firstChild, packed.begin() + node.firstChild + node.childCount, true );
+	return true;
+}
+
+const size_t stringRecordSize = 2 * sizeof( uint64_t );
+const size_t nodeRecordSize = sizeof( uint32_t ) + stringRecordSize + 2 * sizeof( uint64_t );
+
+}
+
+namespace IOC {
+
+void enableConfigCache( str_cref cacheDir )
+{
+	cacheSettings().enabled = true;
+	cacheSettings().directory = cacheDir;
+}
+
+void disableConfigCache()
+{
+	cacheSettings().enabled = false;
+}
+
+namespace detail {
+
+std::string configCachePath( str_cref configPath )
+{
+	CacheSettings const& settings = cacheSettings();
+	if( !settings.enabled )
+	{
+		return std::string();
+	}
+	else if( settings.directory.empty() )
+	{
+		return configPath + 'c'; // foo.ioc -> foo.iocc
+	}
+	else
+	{
+		// configs with the same name in different directories must not collide
+		boost::filesystem::path path( configPath );
+		std::string fullPath = boost::filesystem::absolute( path ).string();
+		std::ostringstream oss;
+		oss << settings.directory << '/' << path.stem().string() << '.'
+			<< std::hex << hashText( fullPath ) << ".iocc";
+		return oss.str();
+	}
+}
+
+bool readConfigCache( str_cref cachePath, str_cref configPath,
+		std::map< std::string, RecursiveExpressionPtr > & config, FileStamps & files )
+{
+	MappedFile file;
+	if( !file.open( cachePath ) )
+	{
+		return false;
+	}
+
+	CacheReader reader( file.text() );
+	if( reader.getString() != configPath )
+	{
+		return false;
+	}
+
+	// the cache is only good if every file it was compiled from is unchanged.
+	// If the size and time match we take it as is, otherwise check the content
+	FileStamps compiledFrom;
+	uint64_t fileCount = reader.getCount( 2 * stringRecordSize );
+	for( uint64_t i = 0; i < fileCount && reader.ok(); ++i )
+	{
+		std::string path( reader.getString() );
+		FileStamp stamp;
+		stamp.mtime = reader.get< int64_t >();
+		stamp.size = reader.get< uint64_t >();
+		stamp.hash = reader.get< uint64_t >();
+		stamp.recent = reader.get< uint8_t >() != 0;
+
+		if( !reader.ok() || !unchanged( path, stamp ) )
+		{
+			return false;
+		}
+		compiledFrom.insert( std::make_pair( path, stamp ) );
+	}
+
+	// #define values only come from the files above so are validated with them
+	uint64_t defineCount = reader.getCount( 2 * stringRecordSize );
+	for( uint64_t i = 0; i < defineCount; ++i )
+	{
+		reader.getString();
+		reader.getString();
+	}
+
+	std::vector< std::pair< std::string_view, uint64_t > > entries( reader.getCount( stringRecordSize ) );
+	for( std::pair< std::string_view, uint64_t > & entry : entries )
+	{
+		entry.first = reader.getString();
+		entry.second = reader.get< uint64_t >();
+	}
+
+	std::vector< CacheNode > nodes( reader.getCount( nodeRecordSize ) );
+	for( std::pair< std::string_view, uint64_t > const& entry : entries )
+	{
+		if( entry.second >= nodes.size() )
+		{
+			return false;
+		}
+	}
+	for( size_t i = 0; i < nodes.size() && reader.ok(); ++i )
+	{
+		CacheNode & node = nodes[i];
+		uint32_t type = reader.get< uint32_t >();
+		node.type = static_cast< ExpressionType >( type );
+		node.value = reader.getString();
+		node.firstChild = reader.get< uint64_t >();
+		node.childCount = reader.get< uint64_t >();
+
+		// children after their parent means no cycles, whatever is in the file
+		if( type >= EError || ( node.childCount &&
+			( node.firstChild <= i || node.firstChild > nodes.size() ||
+				node.childCount > nodes.size() - node.firstChild ) ) )
+		{
+			return false;
+		}
+	}
+
+	if( !reader.ok() )
+	{
+		return false;
+	}
+
+	std::cerr << "Loading compiled config " << cachePath << '\n';
+	// the nodes are already laid out as the arena wants them
+	spns::shared_ptr< ExpressionArena > arena( new ExpressionArena );
+	RecursiveExpression * exprs = arena->allocate( nodes.size() );
+	std::vector< bool > packed( nodes.size(), false );
+	try
+	{
+		for( size_t i = 0; i < nodes.size(); ++i )
+		{
+			CacheNode const& node = nodes[i];
+			if( packed[i] )
+			{
+				continue; // part of the List before it
+			}
+			else if( packList( node, nodes, packed ) )
+			{
+				LiteralArray elements( nodes[ node.firstChild ].type );
+				for( size_t child = node.firstChild; child != node.firstChild + node.childCount; ++child )
+				{
+					if( !elements.add( nodes[child].value ) )
+					{
+						return false;
+					}
+				}
+				arena->set( exprs[i], node.value, std::move( elements ) );
+			}
+			else
+			{
+				arena->set( exprs[i], node.value, node.type,
+					node.childCount ? exprs + node.firstChild : NULL, node.childCount );
+			}
+		}
+	}
+	catch( std::invalid_argument const& ) // a literal value that does not decode
+	{
+		return false;
+	}
+
+	std::map< std::string, RecursiveExpressionPtr > loaded;
+	for( std::pair< std::string_view, uint64_t > const& entry : entries )
+	{
+		loaded.insert( std::make_pair( std::string( entry.first ), arena->share( exprs + entry.second ) ) );
+	}
+
+	config.swap( loaded );
+	files.swap( compiledFrom );
+	return true;
+}
+
+void writeConfigCache( str_cref cachePath, str_cref configPath,
+		FileStamps const& files,
+		std::unordered_map< std::string, std::string > const& defines,
+		std::map< std::string, RecursiveExpressionPtr > const& config )
+{
+	CacheWriter writer;
+	writer.putString( configPath );
+
+	// stamped as they were read, so a file changed since does not validate what was parsed
+	writer.put< uint64_t >( files.size() );
+	for( std::pair< const std::string, FileStamp > const& file : files )
+	{
+		writer.putString( file.first );
+		writer.put( file.second.mtime );
+		writer.put( file.second.size );
+		writer.put( file.second.hash );
+		writer.put< uint8_t >( file.second.recent );
+	}
+
+	writer.put< uint64_t >( defines.size() );
+	for( std::pair< const std::string, std::string > const& define : defines )
+	{
+		writer.putString( define.first );
+		writer.putString( define.second );
+	}
+
+	// lay the nodes out breadth-first so the children of each are contiguous
+	std::vector< const RecursiveExpression * > nodes;
+	writer.put< uint64_t >( config.size() );
+	for( std::pair< const std::string, RecursiveExpressionPtr > const& entry : config )
+	{
+		writer.putString( entry.first );
+		writer.put< uint64_t >( nodes.size() );
+		nodes.push_back( entry.second.get() );
+	}
+
+	std::deque< std::pair< const RecursiveExpression *, uint64_t > > pending;
+	for( size_t i = 0; i < nodes.size(); ++i )
+	{
+		pending.push_back( std::make_pair( nodes[i], i ) );
+	}
+
+	// packed Lists are written as ordinary ones, and packed again when read
+	ExpressionArena expanded;
+	std::vector< uint64_t > firstChild( nodes.size() );
+	std::vector< uint64_t > childCount( nodes.size() );
+	while( !pending.empty() )
+	{
+		const RecursiveExpression * expr = pending.front().first;
+		uint64_t idx = pending.front().second;
+		pending.pop_front();
+
+		const RecursiveExpression * children = expr->params().empty() ? NULL : &expr->paramAt( 0 );
+		size_t numChildren = expr->params().size();
+		if( const LiteralArray * elements = expr->literals() )
+		{
+			children = expanded.expand( *elements );
+			numChildren = elements->size();
+		}
+
+		firstChild[idx] = nodes.size();
+		childCount[idx] = numChildren;
+		for( size_t i = 0; i < numChildren; ++i )
+		{
+			firstChild.push_back( 0 );
+			childCount.push_back( 0 );
+			pending.push_back( std::make_pair( children + i, nodes.size() ) );
+			nodes.push_back( children + i );
+		}
+	}
+
+	writer.put< uint64_t >( nodes.size() );
+	for( size_t i = 0; i < nodes.size(); ++i )
+	{
+		writer.put< uint32_t >( nodes[i]->type() );
+		writer.putString( nodes[i]->value() );
+		writer.put< uint64_t >( firstChild[i] );
+		writer.put< uint64_t >( childCount[i] );
+	}
+
+	// write to the side and rename so another process never sees half a cache
+	std::string tempPath = cachePath + boost::filesystem::unique_path( ".%%%%%%%%" ).string();
+	boost::system::error_code err;
+	if( writer.write( tempPath ) )
+	{
+		boost::filesystem::rename( tempPath, cachePath, err );
+	}
+	else
+	{
+		err = boost::system::errc::make_error_code( boost::system::errc::io_error );
+	}
+
+	if( err )
+	{
+		boost::filesystem::remove( tempPath, err );
+		std::cerr << "Could not write compiled config " << cachePath << '\n';
+	}
+}
+
+} }
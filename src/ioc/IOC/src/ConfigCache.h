@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef IOC_CONFIG_CACHE_H_
+#define IOC_CONFIG_CACHE_H_
+
+#include <IOC/iocfwd.h>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace IOC { namespace detail {
+
+// A compiled config (.iocc) is the parsed map of expressions written out in binary
+// together with what it was compiled from, so a process that starts again with
+// nothing changed can skip parsing altogether.
+
+// What a file was like when a config was loaded from it, to tell later if it has changed
+struct FileStamp
+{
+	int64_t mtime; // in nanoseconds, as finely as the file system keeps it
+	uint64_t size;
+	uint64_t hash; // of the content, if asked for
+	bool recent; // modified too close to being stamped for its time to show a later change
+};
+
+// every config file a config was loaded from, as it was when it was read
+typedef std::map< std::string, FileStamp > FileStamps;
+
+// false if the file cannot be read
+bool stampFile( str_cref path, FileStamp & stamp, bool withHash );
+
+// Stamping what was read from a file rather than the file itself, so a change made while
+// it was read cannot be taken for what was read. The time must be taken before the text
+// is read, and if it could not be the stamp is left recent.
+bool stampTime( str_cref path, FileStamp & stamp );
+void stampText( std::string_view text, FileStamp & stamp );
+
+// If the size and time match it is taken as unchanged, otherwise the content is checked,
+// so the stamp must have been taken with its hash. A recent stamp always has its content
+// checked.
+bool unchanged( str_cref path, FileStamp const& stamp );
+
+// where the compiled form of this config lives. Empty if caching is turned off
+std::string configCachePath( str_cref configPath );
+
+// returns false, leaving config empty, if there is no cache or it is out of date
+// or unreadable. Never throws because of a bad cache file, we just parse again.
+// Otherwise files are those it was compiled from.
+bool readConfigCache( str_cref cachePath, str_cref configPath,
+		std::map< std::string, RecursiveExpressionPtr > & config, FileStamps & files );
+
+// files are all the config files that were loaded, stamped as they were read, defines the
+// #define values in them. Failure to write is reported but is not an error.
+void writeConfigCache( str_cref cachePath, str_cref configPath,
+		FileStamps const& files,
+		std::unordered_map< std::string, std::string > const& defines,
+		std::map< std::string, RecursiveExpressionPtr > const& config );
+
+} }
+
+#endif
@@ -2,26 +2,76 @@
 
 #include <IOC/Builder.h>
 #include <IOC/detail/ObjectLoader.h>
+#include <IOC/detail/Profiling.h>
 #include "StructuredConfigData.h"
+#include "ConcurrentConstruction.h"
+#include "ConfigCache.h"
+#include "LibraryPrefetch.h"
+#include "FlatConfig.h"
+#include "SymbolTable.h"
+#include "UnparsedConfig.h"
 #include <IOC/Libraries.h>
 #include "Utility/mapLookup.h"
 #include <IOC/detail/RecursiveExpression.h>
 #include <IOC/Runnable.h>
 #include <IOC/ioc_api.h>
-#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+#include <mutex>
+#include <boost/filesystem.hpp>
 // ConfigObjectLoader uses Config to provide the values.
 // Config itself is just in essence a map<string,string>
 
 const char * const typestr[] = { "String", "Bool", "Int", "Real", "Void", "Variable",
 	"List", "Map", "Concat", "Library", "Class", "Pair", "Object", "CurrentDir", "Error" };
 
+namespace {
+	// messages describe a folded Concat as it was written
+	IOC::expr_cref asWritten( IOC::expr_cref expr )
+	{
+		return expr.foldedFrom() ? *expr.foldedFrom() : expr;
+	}
+}
+
 
 namespace IOC { namespace detail {
 
+ConfigLayout & configLayout()
+{
+	static ConfigLayout layout = ETreeLayout;
+	return layout;
+}
+
+ConfigParsing & configParsing()
+{
+	static ConfigParsing parsing = EEagerParse;
+	return parsing;
+}
+
+size_t & constructionThreads()
+{
+	static size_t threads = 1;
+	return threads;
+}
+
+struct LibraryOpeningSettings
+{
+	LibraryOpening opening = EOpenWhenUsed;
+	size_t threads = 0;
+};
+
+LibraryOpeningSettings & libraryOpening()
+{
+	static LibraryOpeningSettings settings;
+	return settings;
+}
+
 	// This function implemented in LoadIOCConfig.cpp
 	// In some ways this decouples the actual format of the config file with the ConfigObjectLoader itself.
 
-void loadIOCConfigInto( str_cref filePath, std::map< std::string, RecursiveExpressionPtr > & config );
+void loadIOCConfigInto( str_cref filePath, std::map< std::string, RecursiveExpressionPtr > & config,
+		FileStamps & files );
 
 // we deal with expressions, not strings
 // We therefore need to redesign this.
@@ -29,14 +79,41 @@ void loadIOCConfigInto( str_cref filePath, std::map< std::string, RecursiveExpre
 class ConfigObjectLoader : public ObjectLoader
 {
 private:
-	// this is a map created by loading the config
-	std::map< std::string, RecursiveExpressionPtr > m_config;
+	// What a name resolves to, following any chain of variables
+	struct Resolved
+	{
+		RecursiveExpression::LinkState state;
+		const RecursiveExpression * target;
+		std::string const* name;
+	};
+
+	// states of an expression in a config loaded lazily
+	enum Preparation { EUnprepared, EPreparing, EPrepared };
+
+	// Every name defined in the config is a symbol, numbered in name order. The
+	// expression, class and object for a name are all indexed by its symbol
+	SymbolTable m_symbols;
+
+	// the same config in flat layout, if that was selected
+	spns::shared_ptr< FlatConfig > m_flat;
+
+	// Loaded lazily, each value is parsed into m_arena the first time it is wanted, then its
+	// variables are linked and Concats folded before it is handed out. Anything it links to
+	// is prepared at the same time. m_source holds the text of the values
+	spns::shared_ptr< ConfigLoader > m_source;
+	std::vector< UnparsedValue > m_unparsed;
+	spns::shared_ptr< ExpressionArena > m_arena;
 
 	// We lazy-load everything so all these must be mutable
 	// Note this is all done single-threaded so there is no danger or need for boost::once etc.
+	// Objects may be constructed concurrently afterwards but that never comes back here.
 	
-	mutable std::map< std::string, ClassInfoPtr > m_classes;
-	mutable std::map< std::string, ObjectInfoPtr > m_objects;
+	mutable std::vector< RecursiveExpressionPtr > m_config;
+	mutable std::vector< ClassInfoPtr > m_classes;
+	mutable std::vector< ObjectInfoPtr > m_objects;
+	mutable std::vector< Resolved > m_resolved;
+	mutable std::vector< bool > m_onPath;
+	mutable std::vector< char > m_prepared;
 
 	// we could also map all the others for efficiency if we want to be efficient
 	// especially the more complex ones like maps. It is not important to be efficient though.
@@ -44,15 +121,56 @@ private:
 	// definition and one class instance.
 	LibraryTable & theLibraryTable;
 
+	FileStamps m_files; // every config file it was loaded from, as it was read
+
+	// libraries being opened ahead, and those being opened on this thread now
+	std::unique_ptr< LibraryPrefetch > m_prefetch;
+	mutable std::vector< std::string > m_openingLibraries;
+
 public:
 	ConfigObjectLoader( LibraryTable & libraries, str_cref filePath )
 		: theLibraryTable( libraries ) 
 	{
-		loadIOCConfigInto( filePath, m_config );
+		ProfileScope timing( EParsePhase, filePath );
+		if( configParsing() == ELazyParse && configLayout() == ETreeLayout )
+		{
+			loadUnparsed( filePath );
+			prefetchLibraries();
+			return;
+		}
+
+		std::map< std::string, RecursiveExpressionPtr > config;
+		loadIOCConfigInto( filePath, config, m_files );
+		if( configLayout() == EFlatLayout )
+		{
+			m_flat.reset( new FlatConfig( config ) );
+		}
+
+		// moved across one at a time as the config can be large
+		m_config.reserve( config.size() );
+		m_symbols.reserve( config.size() );
+		while( !config.empty() )
+		{
+			std::map< std::string, RecursiveExpressionPtr >::node_type entry = config.extract( config.begin() );
+			m_symbols.intern( std::move( entry.key() ) );
+			m_config.push_back( std::move( entry.mapped() ) );
+		}
+		m_classes.resize( m_config.size() );
+		m_objects.resize( m_config.size() );
+
+		linkVariables();
+		foldConcats();
+		prefetchLibraries();
+	}
+
+	FileStamps const& files() const
+	{
+		return m_files;
 	}
 
 	expr_cref lookup( str_cref name ) const;
-	const RecursiveExpression * lookupNoThrow( str_cref name ) const;
+	void definitions( std::vector< std::string > & names ) const;
+	const RecursiveExpression * lookupNoThrow( std::string_view name ) const;
 	// This is always returned as a vector of strings. If they are objects, you then
 	// need to resolve the objects. If you want numbers they must be lexically cast.
 
@@ -76,6 +194,11 @@ public:
 	virtual void toVector( expr_cref value, std::vector< RecursiveExpressionPtr > & res ) const;
 	// after which w convert each expression returned
 
+	virtual bool toLiteralVector( expr_cref value, std::vector< double > & res ) const;
+	virtual bool toLiteralVector( expr_cref value, std::vector< int > & res ) const;
+	virtual bool toLiteralVector( expr_cref value, std::vector< size_t > & res ) const;
+	virtual bool toLiteralVector( expr_cref value, std::vector< std::string > & res ) const;
+
 	// to convert to a map we have to go through this...
 	virtual void toMap( expr_cref value, 
 		std::vector< std::pair< RecursiveExpressionPtr, RecursiveExpressionPtr > > & res ) const;
@@ -89,19 +212,39 @@ public:
 
 	virtual expr_cref underlying( expr_cref start, std::string * lastvar = NULL, bool throwIfNotFound=true ) const;
 private:
+	// the elements if value is a packed List of that type
+	const LiteralArray * packedLiterals( expr_cref value, ExpressionType type,
+		ExpressionType alsoType = EError ) const;
+
+	void loadUnparsed( str_cref filePath );
+	RecursiveExpression & parsed( SymbolTable::symbol_id id ) const;
+	expr_cref prepared( SymbolTable::symbol_id id ) const;
+	void prepare( SymbolTable::symbol_id id ) const;
+
+	void linkVariables();
+	void resolve( SymbolTable::symbol_id start ) const;
+	void link( RecursiveExpression & root, std::vector< SymbolTable::symbol_id > * targets ) const;
+	void foldConcats();
+	void foldConcats( RecursiveExpression & root, std::vector< const RecursiveExpression * > & folding ) const;
+	bool foldConcat( RecursiveExpression & concat, std::vector< const RecursiveExpression * > & folding ) const;
+	void throwUndefined( str_cref name ) const;
+	void throwCircular( str_cref name ) const;
+
 	ObjectInfoPtr getObjectInfo( expr_cref expr, str_cref name ) const;
 	ClassInfoPtr getClassInfo( str_cref name ) const;
 	const Library & getLibrary( str_cref name ) const;
+	void libraryDependencies( str_cref name, expr_cref expr, std::vector< std::string > & names ) const;
+	void prefetchLibraries();
 
 };
 
 
-RecursiveExpression const* ConfigObjectLoader::lookupNoThrow( str_cref name ) const
+RecursiveExpression const* ConfigObjectLoader::lookupNoThrow( std::string_view name ) const
 {
-	RecursiveExpressionPtr expr;
-	if( Utility::mapLookup( m_config, name, expr ) )
+	SymbolTable::symbol_id id = m_symbols.find( name );
+	if( id != SymbolTable::npos )
 	{
-		return expr.get();
+		return &prepared( id );
 	}
 	else
 	{
@@ -109,23 +252,388 @@ RecursiveExpression const* ConfigObjectLoader::lookupNoThrow( str_cref name ) co
 	}
 }
 
+void ConfigObjectLoader::throwUndefined( str_cref name ) const
+{
+	std::ostringstream oss;
+	oss << "Undefined value or unexpected enum " << name;
+	throw std::invalid_argument( oss.str() );
+}
+
+void ConfigObjectLoader::throwCircular( str_cref name ) const
+{
+	std::ostringstream oss;
+	oss << "Circular reference resolving " << name;
+	throw std::invalid_argument( oss.str() );
+}
+
 expr_cref ConfigObjectLoader::lookup( str_cref name ) const
 {
 	const RecursiveExpression * expr = lookupNoThrow( name );
-	if( expr )
+	if( !expr )
 	{
-		return *expr;
+		throwUndefined( name );
 	}
-	else
+	return *expr;
+}
+
+void ConfigObjectLoader::definitions( std::vector< std::string > & names ) const
+{
+	names.reserve( names.size() + m_symbols.size() );
+	for( SymbolTable::symbol_id id = 0; id < m_symbols.size(); ++id )
 	{
-		std::ostringstream oss;
-		oss << "Undefined value or unexpected enum " << name;
-		throw std::invalid_argument( oss.str() );
+		names.push_back( m_symbols.str( id ) );
+	}
+}
+
+void ConfigObjectLoader::loadUnparsed( str_cref filePath )
+{
+	std::map< std::string, UnparsedValue > values;
+	m_source = loadIOCConfigUnparsed( filePath, values, m_files );
+	m_arena.reset( new ExpressionArena );
+
+	m_unparsed.reserve( values.size() );
+	m_symbols.reserve( values.size() );
+	while( !values.empty() )
+	{
+		std::map< std::string, UnparsedValue >::node_type entry = values.extract( values.begin() );
+		m_symbols.intern( std::move( entry.key() ) );
+		m_unparsed.push_back( entry.mapped() );
+	}
+
+	const size_t count = m_unparsed.size();
+	m_config.resize( count );
+	m_classes.resize( count );
+	m_objects.resize( count );
+	Resolved unresolved = { RecursiveExpression::ENotLinked, NULL, NULL };
+	m_resolved.resize( count, unresolved );
+	m_onPath.resize( count, false );
+	m_prepared.resize( count, EUnprepared );
+}
+
+// the expression for a symbol, parsed now if it has not been yet
+RecursiveExpression & ConfigObjectLoader::parsed( SymbolTable::symbol_id id ) const
+{
+	if( !m_config[id] )
+	{
+		ProfileScope timing( EParsePhase, m_symbols.str( id ) );
+		UnparsedValue const& value = m_unparsed[id];
+		RecursiveExpressionPtr expr = RecursiveExpression::parse( value.m_text, *value.m_currentDir, *m_arena );
+		if( expr->type() == EError )
+		{
+			std::ostringstream oss;
+			oss << expr->value() << "\n\tdefining " << m_symbols.str( id ) << " in file " << *value.m_path;
+			throw std::invalid_argument( oss.str() );
+		}
+		m_config[id] = expr;
+	}
+	return *m_config[id];
+}
+
+// the expression for a symbol, ready to be used
+expr_cref ConfigObjectLoader::prepared( SymbolTable::symbol_id id ) const
+{
+	if( !m_prepared.empty() && m_prepared[id] != EPrepared )
+	{
+		prepare( id );
+	}
+	return *m_config[id];
+}
+
+// Links and folds the expression and everything it links to that is not yet prepared.
+// Nothing is marked prepared until all of it is, so if any of it fails to parse, looking
+// it up again fails the same way.
+void ConfigObjectLoader::prepare( SymbolTable::symbol_id id ) const
+{
+	std::vector< SymbolTable::symbol_id > pending( 1, id );
+	std::vector< SymbolTable::symbol_id > preparing;
+	std::vector< const RecursiveExpression * > folding;
+	try
+	{
+		while( !pending.empty() )
+		{
+			SymbolTable::symbol_id next = pending.back();
+			pending.pop_back();
+			if( m_prepared[next] != EUnprepared )
+			{
+				continue;
+			}
+			m_prepared[next] = EPreparing;
+			preparing.push_back( next );
+
+			RecursiveExpression & expr = parsed( next );
+			link( expr, &pending );
+			foldConcats( expr, folding );
+		}
 	}
+	catch( ... )
+	{
+		for( SymbolTable::symbol_id member : preparing )
+		{
+			m_prepared[member] = EUnprepared;
+		}
+		throw;
+	}
+
+	for( SymbolTable::symbol_id member : preparing )
+	{
+		m_prepared[member] = EPrepared;
+	}
+}
+
+// Resolves every variable in the config once, so underlying() does not have to walk
+// the chain of variables each time. What a chain of variables resolves to is worked out
+// for each name first, then every variable expression is linked to the result for its name.
+// A circular chain is only an error if something uses it, as it always was.
+
+void ConfigObjectLoader::linkVariables()
+{
+	const size_t count = m_config.size();
+	Resolved unresolved = { RecursiveExpression::ENotLinked, NULL, NULL };
+	m_resolved.assign( count, unresolved );
+	m_onPath.assign( count, false );
+
+	for( SymbolTable::symbol_id start = 0; start < count; ++start )
+	{
+		resolve( start );
+	}
+	for( RecursiveExpressionPtr const& expr : m_config )
+	{
+		link( *expr, NULL );
+	}
+
+	std::vector< Resolved >().swap( m_resolved );
+	std::vector< bool >().swap( m_onPath );
+}
+
+// Works out what the chain of variables from a name resolves to, for every name on it.
+// Loaded lazily, each name on the chain is parsed as it is reached.
+void ConfigObjectLoader::resolve( SymbolTable::symbol_id start ) const
+{
+	const RecursiveExpression::LinkState unresolved = RecursiveExpression::ENotLinked;
+	Resolved init = { unresolved, NULL, NULL };
+	std::vector< SymbolTable::symbol_id > path;
+
+	try
+	{
+		// follow the chain until it ends or reaches a name already resolved
+		SymbolTable::symbol_id id = start;
+		Resolved end = init;
+		bool ended = false;
+		while( !ended && m_resolved[id].state == unresolved )
+		{
+			ended = true;
+			if( m_onPath[id] )
+			{
+				// every name from here on is in the cycle, those before lead into it
+				bool inCycle = false;
+				for( SymbolTable::symbol_id member : path )
+				{
+					inCycle = inCycle || member == id;
+					Resolved circular = { RecursiveExpression::ECircularLink, NULL, 
+						&m_symbols.str( inCycle ? member : id ) };
+					m_resolved[member] = circular;
+				}
+				continue;
+			}
+			m_onPath[id] = true;
+			path.push_back( id );
+
+			expr_cref expr = parsed( id );
+			SymbolTable::symbol_id next = SymbolTable::npos;
+			if( expr.type() == EVariable )
+			{
+				next = m_symbols.find( expr.value() );
+				if( next == SymbolTable::npos )
+				{
+					Resolved undefined = { RecursiveExpression::EUndefinedLink, &expr, &expr.value() };
+					end = undefined;
+				}
+				else
+				{
+					id = next;
+					ended = false;
+				}
+			}
+			else
+			{
+				Resolved found = { RecursiveExpression::ELinked, &expr, &m_symbols.str( id ) };
+				end = found;
+			}
+		}
+
+		if( !ended )
+		{
+			end = m_resolved[id]; // reached a name that was already resolved
+		}
+
+		for( SymbolTable::symbol_id member : path )
+		{
+			if( m_resolved[member].state == unresolved )
+			{
+				m_resolved[member] = end;
+			}
+		}
+	}
+	catch( ... ) // something on the chain failed to parse, nothing is resolved
+	{
+		for( SymbolTable::symbol_id member : path )
+		{
+			m_resolved[member] = init;
+			m_onPath[member] = false;
+		}
+		throw;
+	}
+
+	for( SymbolTable::symbol_id member : path )
+	{
+		m_onPath[member] = false;
+	}
+}
+
+// Links every variable within the expression, resolving its name first if it has not
+// been. The symbols of the expressions linked to are added to targets if it is given.
+void ConfigObjectLoader::link( RecursiveExpression & root, std::vector< SymbolTable::symbol_id > * targets ) const
+{
+	std::vector< RecursiveExpression * > pending( 1, &root );
+	while( !pending.empty() )
+	{
+		RecursiveExpression * expr = pending.back();
+		pending.pop_back();
+
+		if( expr->type() == EVariable )
+		{
+			SymbolTable::symbol_id id = m_symbols.find( expr->value() );
+			if( id == SymbolTable::npos )
+			{
+				expr->link( RecursiveExpression::EUndefinedLink, expr, expr->value() );
+				continue;
+			}
+
+			if( m_resolved[id].state == RecursiveExpression::ENotLinked )
+			{
+				resolve( id );
+			}
+			Resolved const& resolved = m_resolved[id];
+			expr->link( resolved.state, resolved.target, *resolved.name );
+			if( targets && resolved.state == RecursiveExpression::ELinked )
+			{
+				targets->push_back( m_symbols.find( *resolved.name ) );
+			}
+		}
+		else
+		{
+			for( size_t i = 0; i < expr->params().size(); ++i )
+			{
+				pending.push_back( const_cast< RecursiveExpression * >( &expr->paramAt( i ) ) );
+			}
+		}
+	}
+}
+
+// A Concat whose parts are all strings, or variables that are, is folded into the string it
+// makes so toString does not put it together every time it is used. This follows
+// linkVariables as it uses the links. Anything that is not constant, or would be an error
+// when used, is left to be evaluated as before.
+
+void ConfigObjectLoader::foldConcats()
+{
+	std::vector< const RecursiveExpression * > folding;
+	for( RecursiveExpressionPtr const& expr : m_config )
+	{
+		foldConcats( *expr, folding );
+	}
+}
+
+void ConfigObjectLoader::foldConcats( RecursiveExpression & root, std::vector< const RecursiveExpression * > & folding ) const
+{
+	std::vector< RecursiveExpression * > pending( 1, &root );
+	while( !pending.empty() )
+	{
+		RecursiveExpression * expr = pending.back();
+		pending.pop_back();
+
+		// a Concat that folds has no parts left to look at
+		if( expr->type() != EConcat || !foldConcat( *expr, folding ) )
+		{
+			for( size_t i = 0; i < expr->params().size(); ++i )
+			{
+				pending.push_back( const_cast< RecursiveExpression * >( &expr->paramAt( i ) ) );
+			}
+		}
+	}
+}
+
+// folding holds the Concats being folded, as one could refer to itself
+bool ConfigObjectLoader::foldConcat( RecursiveExpression & concat, std::vector< const RecursiveExpression * > & folding ) const
+{
+	if( std::find( folding.begin(), folding.end(), &concat ) != folding.end() )
+	{
+		return false;
+	}
+
+	folding.push_back( &concat );
+	std::vector< const RecursiveExpression * > parts;
+	size_t size = 0;
+	for( size_t i = 0; i < concat.params().size(); ++i )
+	{
+		const RecursiveExpression * part = &concat.paramAt( i );
+		if( part->type() == EVariable )
+		{
+			part = part->linkState() == RecursiveExpression::ELinked ? &part->target() : NULL;
+		}
+		if( part && part->type() == EConcat )
+		{
+			foldConcat( const_cast< RecursiveExpression & >( *part ), folding );
+		}
+		if( !part || part->type() != EString )
+		{
+			break;
+		}
+		parts.push_back( part );
+		size += part->value().size();
+	}
+	folding.pop_back();
+
+	if( parts.size() != concat.params().size() )
+	{
+		return false;
+	}
+
+	std::string value;
+	value.reserve( size );
+	for( const RecursiveExpression * part : parts )
+	{
+		value.append( part->value() );
+	}
+	concat.fold( std::move( value ) );
+	return true;
 }
 
 expr_cref ConfigObjectLoader::underlying( expr_cref start, std::string * lastvar, bool throwIfNotFound ) const
 {
+	switch( start.linkState() )
+	{
+	case RecursiveExpression::ELinked:
+		if( lastvar )
+			*lastvar = start.targetName();
+		return start.target();
+
+	case RecursiveExpression::EUndefinedLink:
+		if( lastvar )
+			*lastvar = start.targetName();
+		if( throwIfNotFound )
+		{
+			throwUndefined( start.targetName() );
+		}
+		return start.target();
+
+	case RecursiveExpression::ECircularLink:
+		throwCircular( start.targetName() );
+
+	default: // not a variable, or not from this config
+		break;
+	}
+
 	const RecursiveExpression * pexpr = &start;
 
 	std::set< std::string > seen;
@@ -135,9 +643,7 @@ expr_cref ConfigObjectLoader::underlying( expr_cref start, std::string * lastvar
 		std::string varname = pexpr->value();
 		if( !seen.insert( varname ).second )
 		{
-			std::ostringstream oss;
-			oss << "Circular reference resolving " << varname;
-			throw std::invalid_argument( oss.str() );
+			throwCircular( varname );
 		}
 
 		if( lastvar )
@@ -171,10 +677,17 @@ int ConfigObjectLoader::toInt( expr_cref value ) const
 	if( expr.type() != EInt )
 	{
 		std::ostringstream oss;
-		oss << "expected int, got " << expr.value() << " interpreted as " << typestr[expr.type()];
+		oss << "expected int, got " << asWritten( expr ).value() << " interpreted as " << typestr[asWritten( expr ).type()];
 		throw TypeError( oss.str() );
 	}
-	return boost::lexical_cast<int>( expr.value() );
+	// the value was decoded when it was parsed so just needs to fit
+	if( expr.intValue() < std::numeric_limits< int >::min() || expr.intValue() > std::numeric_limits< int >::max() )
+	{
+		std::ostringstream oss;
+		oss << "Expected int, got " << expr.value() << " which is out of range";
+		throw std::invalid_argument( oss.str() );
+	}
+	return static_cast< int >( expr.intValue() );
 }
 
 double ConfigObjectLoader::toDouble( expr_cref value ) const
@@ -185,10 +698,10 @@ double ConfigObjectLoader::toDouble( expr_cref value ) const
 	if( expr.type() != EReal && expr.type() != EInt )
 	{
 		std::ostringstream oss;
-		oss << "expected a number, got " << expr.value() << " interpreted as " << typestr[expr.type()];
+		oss << "expected a number, got " << asWritten( expr ).value() << " interpreted as " << typestr[asWritten( expr ).type()];
 		throw TypeError( oss.str() );
 	}
-	return boost::lexical_cast<double>( expr.value() );
+	return expr.type() == EInt ? static_cast< double >( expr.intValue() ) : expr.realValue();
 }
 
 size_t ConfigObjectLoader::toUInt( expr_cref value ) const
@@ -198,20 +711,16 @@ size_t ConfigObjectLoader::toUInt( expr_cref value ) const
 	if( expr.type() != EInt )
 	{
 		std::ostringstream oss;
-		oss << "expected unsigned int, got " << expr.value() << " interpreted as " << typestr[expr.type()];
+		oss << "expected unsigned int, got " << asWritten( expr ).value() << " interpreted as " << typestr[asWritten( expr ).type()];
 		throw TypeError( oss.str() );
 	}
-	try
+	if( expr.intValue() < 0 || static_cast< uint64_t >( expr.intValue() ) > std::numeric_limits< size_t >::max() )
 	{
-		return boost::lexical_cast<size_t>( expr.value() );
-	}
-	catch( std::exception const& ) // in case it's a negative number in which case I assume it won't cast
-	{
-		// I want to throw my own exception.
 		std::ostringstream oss;
 		oss << "Expected unsigned int, got " << expr.value() << " Which did not convert (is it negative?)";
 		throw std::invalid_argument( oss.str() );
 	}
+	return static_cast< size_t >( expr.intValue() );
 }
 
 
@@ -221,12 +730,12 @@ bool ConfigObjectLoader::toBool( expr_cref value ) const
 	if( expr.type() != EBool )
 	{
 		std::ostringstream oss;
-		oss << "expected boolean, got " << expr.value() << " interpreted as " << typestr[expr.type()] << 
+		oss << "expected boolean, got " << asWritten( expr ).value() << " interpreted as " << typestr[asWritten( expr ).type()] << 
 			" (note, numbers do not convert to booleans)";
 		throw TypeError( oss.str() );
 	}
 	
-	return ( expr.value() == "true" ); // there are stored as "true" and "false". Anything else would not be interpreted as boolean
+	return expr.boolValue();
 }
 
 // For string it is more complex as we have to handle Concat expressions too
@@ -239,11 +748,30 @@ std::string ConfigObjectLoader::toString( expr_cref value ) const
 	}
 	else if( expr.type() == EConcat ) 
 	{
-		std::vector< RecursiveExpressionPtr > const& params = expr.params();
 		std::string res;
-		for( RecursiveExpressionPtr pexp : params )
+		FlatConfig::index_type idx = m_flat ? m_flat->indexOf( expr ) : FlatConfig::npos;
+		if( idx != FlatConfig::npos )
 		{
-			res.append( toString( *pexp ) );
+			// literal strings are appended straight from the pool
+			FlatConfig::index_type end = m_flat->firstChild( idx ) + m_flat->numChildren( idx );
+			for( FlatConfig::index_type child = m_flat->firstChild( idx ); child != end; ++child )
+			{
+				if( m_flat->type( child ) == EString )
+				{
+					res.append( m_flat->value( child ) );
+				}
+				else
+				{
+					res.append( toString( m_flat->expression( child ) ) );
+				}
+			}
+			return res;
+		}
+
+		ExpressionSpan params = expr.params();
+		for( size_t i = 0; i < params.size(); ++i )
+		{
+			res.append( toString( params.at( i ) ) );
 		}
 		return res;
 	}
@@ -271,8 +799,8 @@ std::string ConfigObjectLoader::toEnum( IOC::expr_cref value ) const
 	if( expr.type() != EVariable )
 	{
 		std::ostringstream oss;
-		oss << last << " has been defined to " << expr.value() << " of type " <<
-			typestr[expr.type()] << " expecting an enumeration";
+		oss << last << " has been defined to " << asWritten( expr ).value() << " of type " <<
+			typestr[asWritten( expr ).type()] << " expecting an enumeration";
 		throw TypeError( oss.str() );
 	}
 
@@ -289,12 +817,121 @@ void ConfigObjectLoader::toVector( expr_cref value, std::vector< RecursiveExpres
 	if( expr.type() != EList )
 	{
 		std::ostringstream oss;
-		oss << "expected a list, got " << expr.value() << " interpreted as " << typestr[expr.type()];
+		oss << "expected a list, got " << asWritten( expr ).value() << " interpreted as " << typestr[asWritten( expr ).type()];
 		throw TypeError( oss.str() );
 	}
 
+	// a packed List has to be expanded, into an arena the elements keep alive
+	if( const LiteralArray * elements = expr.literals() )
+	{
+		spns::shared_ptr< ExpressionArena > arena( new ExpressionArena );
+		RecursiveExpression * exprs = arena->expand( *elements );
+		res.clear();
+		res.reserve( elements->size() );
+		for( size_t i = 0; i < elements->size(); ++i )
+		{
+			res.push_back( arena->share( exprs + i ) );
+		}
+		return;
+	}
+
 	// now just populate it
-	res = expr.params();
+	ExpressionSpan params = expr.params();
+	res.assign( params.begin(), params.end() );
+}
+
+const LiteralArray * ConfigObjectLoader::packedLiterals( expr_cref value, ExpressionType type,
+	ExpressionType alsoType ) const
+{
+	expr_cref expr = underlying( value );
+	const LiteralArray * elements = expr.type() == EList ? expr.literals() : NULL;
+	if( elements && ( elements->type() == type || elements->type() == alsoType ) )
+	{
+		return elements;
+	}
+	return NULL;
+}
+
+// These only handle the elements converting. If they don't, toVector gets them
+// converted one at a time, which reports the error just as for an unpacked List
+
+bool ConfigObjectLoader::toLiteralVector( expr_cref value, std::vector< double > & res ) const
+{
+	const LiteralArray * elements = packedLiterals( value, EReal, EInt ); // ints are also doubles
+	if( !elements )
+	{
+		return false;
+	}
+
+	bool isInt = elements->type() == EInt;
+
+	res.resize( elements->size() );
+	for( size_t i = 0; i < res.size(); ++i )
+	{
+		res[i] = isInt ? static_cast< double >( elements->value( i ).m_int ) : elements->value( i ).m_real;
+	}
+	return true;
+}
+
+bool ConfigObjectLoader::toLiteralVector( expr_cref value, std::vector< int > & res ) const
+{
+	const LiteralArray * elements = packedLiterals( value, EInt );
+	if( !elements )
+	{
+		return false;
+	}
+
+	res.resize( elements->size() );
+	for( size_t i = 0; i < res.size(); ++i )
+	{
+		int64_t element = elements->value( i ).m_int;
+		if( element < std::numeric_limits< int >::min() || element > std::numeric_limits< int >::max() )
+		{
+			res.clear();
+			return false;
+		}
+		res[i] = static_cast< int >( element );
+	}
+	return true;
+}
+
+bool ConfigObjectLoader::toLiteralVector( expr_cref value, std::vector< size_t > & res ) const
+{
+	const LiteralArray * elements = packedLiterals( value, EInt );
+	if( !elements )
+	{
+		return false;
+	}
+
+	res.resize( elements->size() );
+	for( size_t i = 0; i < res.size(); ++i )
+	{
+		int64_t element = elements->value( i ).m_int;
+		if( element < 0 )
+		{
+			res.clear();
+			return false;
+		}
+		res[i] = static_cast< size_t >( element );
+	}
+	return true;
+}
+
+bool ConfigObjectLoader::toLiteralVector( expr_cref value, std::vector< std::string > & res ) const
+{
+	const LiteralArray * elements = packedLiterals( value, EString );
+	if( !elements )
+	{
+		return false;
+	}
+
+	res.clear();
+	res.reserve( elements->size() );
+	for( size_t i = 0; i < elements->size(); ++i )
+	{
+		res.emplace_back( elements->text( i ) );
+	}
+	return true;
 }
 
 struct PairConverter
@@ -312,7 +949,7 @@ struct PairConverter
 		if( expr.type() != EPair )
 		{
 			std::ostringstream oss;
-			oss << "Items in a Map must be a Pair: Got " << expr.value() << " type " << typestr[expr.type()];
+			oss << "Items in a Map must be a Pair: Got " << asWritten( expr ).value() << " type " << typestr[asWritten( expr ).type()];
 
 			// not TypeError here, you cannot create a proxy for a pair
 			throw std::invalid_argument( oss.str() );
@@ -334,13 +971,36 @@ void ConfigObjectLoader::toMap( expr_cref value,
 	if( expr.type() != EMap )
 	{
 		std::ostringstream oss;
-		oss << "expected a map, got " << expr.value() << " interpreted as " << typestr[expr.type()]
+		oss << "expected a map, got " << asWritten( expr ).value() << " interpreted as " << typestr[asWritten( expr ).type()]
 		<< " (note: a List of Pair items is not a map)";
 
 		throw TypeError( oss.str() );
 	}
 
-	std::vector<RecursiveExpressionPtr> const& params = expr.params();
+	FlatConfig::index_type idx = m_flat ? m_flat->indexOf( expr ) : FlatConfig::npos;
+	if( idx != FlatConfig::npos )
+	{
+		// pairs written in place need no conversion, only those that are aliases
+		res.clear();
+		res.reserve( m_flat->numChildren( idx ) );
+		PairConverter converter( this );
+		FlatConfig::index_type end = m_flat->firstChild( idx ) + m_flat->numChildren( idx );
+		for( FlatConfig::index_type child = m_flat->firstChild( idx ); child != end; ++child )
+		{
+			if( m_flat->type( child ) == EPair )
+			{
+				FlatConfig::index_type key = m_flat->firstChild( child );
+				res.push_back( std::make_pair( m_flat->share( key ), m_flat->share( key + 1 ) ) );
+			}
+			else
+			{
+				res.push_back( converter( m_flat->share( child ) ) );
+			}
+		}
+		return;
+	}
+
+	ExpressionSpan params = expr.params();
 
 	res.resize( params.size() );
 	std::transform( params.begin(), params.end(), res.begin(), PairConverter( this ) );
@@ -348,6 +1008,12 @@ void ConfigObjectLoader::toMap( expr_cref value,
 
 const Library & ConfigObjectLoader::getLibrary( str_cref name ) const
 {
+	// it may be being opened already
+	if( m_prefetch )
+	{
+		m_prefetch->wait( name );
+	}
+
 	// first check if it is already loaded
 
 	// this next line can't throw but several other calls here could
@@ -361,28 +1027,135 @@ const Library & ConfigObjectLoader::getLibrary( str_cref name ) const
 			oss << name << " is not a library";
 			throw std::invalid_argument( oss.str() );
 		}
-		// a library will always have just 1 parameter and there is no need to check it
-		// It can throw if the parameter cannot evaluate to a string. It may be a Concat and often will be
-		// if you wish to specify a root path in a variable then make all the others come off that
-		std::string path = toString( *(expr.param(0)) );
-		
-		// this can throw if what is in "path" cannot be loaded through LoadLibrary
-		pLib = &( theLibraryTable.addLibrary( name, path ) );
+
+		if( std::find( m_openingLibraries.begin(), m_openingLibraries.end(), name ) != m_openingLibraries.end() )
+		{
+			std::ostringstream oss;
+			oss << "Circular reference opening library " << name;
+			throw std::invalid_argument( oss.str() );
+		}
+
+		// any it needs are opened first
+		m_openingLibraries.push_back( name );
+		try
+		{
+			std::vector< std::string > after;
+			libraryDependencies( name, expr, after );
+			for( std::string const& dep : after )
+			{
+				getLibrary( dep );
+			}
+
+			// It can throw if the parameter cannot evaluate to a string. It may be a Concat and often will be
+			// if you wish to specify a root path in a variable then make all the others come off that
+			std::string path = toString( *(expr.param(0)) );
+			
+			// this can throw if what is in "path" cannot be loaded through LoadLibrary
+			ProfileScope timing( ELibraryLoadPhase, name );
+			pLib = &( theLibraryTable.addLibrary( name, path ) );
+		}
+		catch( ... )
+		{
+			m_openingLibraries.pop_back();
+			throw;
+		}
+		m_openingLibraries.pop_back();
 	}
 	return *pLib;
 }
 
+// the libraries a library needs opened before it, the optional second parameter
+void ConfigObjectLoader::libraryDependencies( str_cref name, expr_cref expr, std::vector< std::string > & names ) const
+{
+	if( expr.params().size() < 2 )
+	{
+		return;
+	}
+
+	std::vector< RecursiveExpressionPtr > deps;
+	try
+	{
+		toVector( *expr.param(1), deps );
+	}
+	catch( std::invalid_argument const& err )
+	{
+		std::ostringstream oss;
+		oss << "Second parameter of library " << name << " must be a list of library aliases\n\t"
+			<< err.what();
+		throw std::invalid_argument( oss.str() );
+	}
+
+	for( RecursiveExpressionPtr const& dep : deps )
+	{
+		if( dep->type() != EVariable )
+		{
+			std::ostringstream oss;
+			oss << "Second parameter of library " << name << " must be a list of library aliases";
+			throw std::invalid_argument( oss.str() );
+		}
+		names.push_back( dep->value() );
+	}
+}
+
+// Starts opening every library the config defines, if asked to. When it was loaded lazily
+// only the values written as a Library are parsed. One that cannot be evaluated here is
+// left to report why when it is used.
+void ConfigObjectLoader::prefetchLibraries()
+{
+	if( libraryOpening().opening != EOpenOnLoad )
+	{
+		return;
+	}
+
+	std::vector< LibraryPrefetch::Request > requests;
+	for( SymbolTable::symbol_id id = 0; id < m_symbols.size(); ++id )
+	{
+		if( !m_unparsed.empty() )
+		{
+			std::string_view text = m_unparsed[id].m_text;
+			size_t start = text.find_first_not_of( " \t\r\n" );
+			if( start == std::string_view::npos || text.compare( start, 7, "Library" ) != 0 )
+			{
+				continue;
+			}
+		}
+
+		try
+		{
+			expr_cref expr = prepared( id );
+			LibraryPrefetch::Request request;
+			request.m_name = m_symbols.str( id );
+			if( expr.type() != ELibrary || theLibraryTable.getLibraryNoThrow( request.m_name ) )
+			{
+				continue;
+			}
+			request.m_path = toString( *expr.param(0) );
+			libraryDependencies( request.m_name, expr, request.m_after );
+			requests.push_back( request );
+		}
+		catch( std::exception const& )
+		{
+		}
+	}
+
+	if( !requests.empty() )
+	{
+		m_prefetch.reset( new LibraryPrefetch( theLibraryTable, requests, libraryOpening().threads ) );
+	}
+}
+
 // checks if the class info has been loaded
 ClassInfoPtr ConfigObjectLoader::getClassInfo( str_cref name ) const
 {
+	SymbolTable::symbol_id id = m_symbols.find( name );
 	ClassInfoPtr cls;
-	if( Utility::mapLookup( m_classes, name, cls ) )
+	if( id != SymbolTable::npos && m_classes[id] )
 	{
-		return cls;
+		cls = m_classes[id];
 	}
 	else
 	{
-		expr_cref expr = lookup( name );
+		expr_cref expr = lookup( name ); // throws if there is no symbol
 		
 		// you cannot realias a class so there is no need to recurse this. It must be of type Class
 		// i.e. you can't do
@@ -429,6 +1202,7 @@ ClassInfoPtr ConfigObjectLoader::getClassInfo( str_cref name ) const
 		{
 			// try loading the symbol. If that fails, give error context.
 			const Library & lib = getLibrary( libName );
+			ProfileScope timing( ESymbolLookupPhase, symbol );
 			sym = lib.getSymbol( symbol, true ); // we do want to throw if it can't load
 
 		}
@@ -451,7 +1225,7 @@ ClassInfoPtr ConfigObjectLoader::getClassInfo( str_cref name ) const
 		}
 
 		cls.reset( new ClassInfo( name, fact ) );
-		m_classes[name] = cls;
+		m_classes[id] = cls;
 	}
 
 	return cls;
@@ -463,15 +1237,13 @@ ClassInfoPtr ConfigObjectLoader::getClassInfo( str_cref name ) const
 
 ObjectInfoPtr ConfigObjectLoader::getObjectInfo( expr_cref expr, str_cref name ) const
 {
-	if( !name.empty() )
-	{
-		ObjectInfoPtr obj;
+	// only names defined in the config can name an object
+	SymbolTable::symbol_id id = name.empty() ? SymbolTable::npos : m_symbols.find( name );
 
-		// already found.
-		if( Utility::mapLookup( m_objects, name, obj ) )
-		{
-			return obj;
-		}
+	// already found.
+	if( id != SymbolTable::npos && m_objects[id] )
+	{
+		return m_objects[id];
 	}
 
 	if( expr.type() == EObject ) // it's an object expression
@@ -482,7 +1254,11 @@ ObjectInfoPtr ConfigObjectLoader::getObjectInfo( expr_cref expr, str_cref name )
         ObjectInfoPtr obj( new ObjectInfo( name, expr, *classInfo, builder ) );
 
         // It needs to be in the map before we bind its parameters so a circular reference can be detected
-        m_objects[name] = obj;
+        if( id != SymbolTable::npos )
+        {
+            m_objects[id] = obj;
+        }
+        ProfileScope timing( EBindPhase, *builder );
         builder->bindParams( *this );
 		return obj;
 	}
@@ -499,7 +1275,7 @@ ObjectInfoPtr ConfigObjectLoader::getObjectInfo( expr_cref expr, str_cref name )
 	else // this isn't a class. It might be a map or list or whatever but isn't an object
 	{
 		std::ostringstream oss;
-		oss << expr.value() << " is not an object";
+		oss << asWritten( expr ).value() << " is not an object";
 
 		// Do not throw TypeError here. If it isn't an object it can't be a proxy either
 		throw std::invalid_argument( oss.str() );
@@ -518,21 +1294,260 @@ BuilderPtr ConfigObjectLoader::getBuilder( expr_cref value ) const
 	return getObjectInfo( value, name )->getBuilder();
 }
 
+// The loaders getRunnable() keeps when the loader cache is enabled, by the canonical path of
+// the config, with the stamps of the files each was loaded from. m_lock only guards the
+// entries, loading and checking the files is done without it. A loader is not thread safe so
+// each kept one has a lock of its own that binding is done under. Constructing does not use
+// the loader, so that lock is not held for it.
+class LoaderRegistry
+{
+public:
+	// what a kept loader is bound under, and whether a call using it has failed
+	struct Use
+	{
+		std::recursive_mutex m_lock;
+		bool m_failed = false;
+	};
+
+	// a loader to use, and what to use it under if it is kept
+	struct Entry
+	{
+		spns::shared_ptr< ConfigObjectLoader > m_loader;
+		spns::shared_ptr< Use > m_use;
+		FileStamps m_stamps;
+	};
+
+private:
+	std::map< std::string, Entry > m_entries;
+	std::atomic< bool > m_enabled; // read without the lock, so a disabled cache never takes it
+	std::mutex m_lock;
+
+	static std::string key( str_cref filePath );
+	static Entry load( str_cref filePath );
+
+public:
+	LoaderRegistry()
+		: m_enabled( false )
+	{
+	}
+
+	void enable( bool enabled )
+	{
+		std::lock_guard< std::mutex > lock( m_lock );
+		m_enabled.store( enabled );
+		if( !enabled )
+		{
+			m_entries.clear();
+		}
+	}
+
+	// a new loader with no lock if the cache is not enabled
+	Entry loader( str_cref filePath );
+	void reload( str_cref filePath );
+
+	// only drops the entry if it is still for this loader, or for any loader if there is none
+	void evict( str_cref filePath, spns::shared_ptr< ConfigObjectLoader > const& loader =
+		spns::shared_ptr< ConfigObjectLoader >() );
+};
+
+LoaderRegistry & loaderRegistry()
+{
+	static LoaderRegistry registry;
+	return registry;
+}
+
+// if the file cannot be found it is left for the loader to report
+std::string LoaderRegistry::key( str_cref filePath )
+{
+	boost::system::error_code err;
+	boost::filesystem::path path = boost::filesystem::canonical( filePath, err );
+	return err ? filePath : path.string();
+}
+
+// The files are stamped as the loader read them, so one changed meanwhile is seen as changed
+LoaderRegistry::Entry LoaderRegistry::load( str_cref filePath )
+{
+	Entry entry;
+	entry.m_loader.reset( new ConfigObjectLoader( libraryTableInstance(), filePath ) );
+	entry.m_use.reset( new Use );
+	entry.m_stamps = entry.m_loader->files();
+	return entry;
+}
+
+LoaderRegistry::Entry LoaderRegistry::loader( str_cref filePath )
+{
+	if( !m_enabled.load() )
+	{
+		Entry entry;
+		entry.m_loader.reset( new ConfigObjectLoader( libraryTableInstance(), filePath ) );
+		return entry;
+	}
+
+	std::string path = key( filePath );
+	std::unique_lock< std::mutex > lock( m_lock );
+	std::map< std::string, Entry >::const_iterator iter = m_entries.find( path );
+	if( iter != m_entries.end() )
+	{
+		Entry entry = iter->second;
+		lock.unlock(); // checking the files can take a while
+
+		bool current = true;
+		for( FileStamps::const_iterator stamp = entry.m_stamps.begin();
+				current && stamp != entry.m_stamps.end(); ++stamp )
+		{
+			current = unchanged( stamp->first, stamp->second );
+		}
+		if( current )
+		{
+			return entry;
+		}
+	}
+	else
+	{
+		lock.unlock();
+	}
+
+	// if another thread loads it at the same time the last to finish is kept
+	Entry entry = load( filePath );
+	lock.lock();
+	if( m_enabled.load() )
+	{
+		m_entries[ path ] = entry;
+	}
+	return entry;
+}
+
+// The entry is only replaced once the config has loaded
+void LoaderRegistry::reload( str_cref filePath )
+{
+	if( !m_enabled.load() )
+	{
+		return;
+	}
+
+	Entry entry = load( filePath );
+	std::string path = key( filePath );
+	std::lock_guard< std::mutex > lock( m_lock );
+	if( m_enabled.load() )
+	{
+		m_entries[ path ] = entry;
+	}
+}
+
+void LoaderRegistry::evict( str_cref filePath, spns::shared_ptr< ConfigObjectLoader > const& loader )
+{
+	std::string path = key( filePath );
+	std::lock_guard< std::mutex > lock( m_lock );
+	std::map< std::string, Entry >::iterator iter = m_entries.find( path );
+	if( iter != m_entries.end() && ( !loader || iter->second.m_loader == loader ) )
+	{
+		m_entries.erase( iter );
+	}
+}
+
 }  // close namespace detail
 
 RunnablePtr getRunnable( str_cref filePath, str_cref name )
 {
 	// any exceptions are passed on
-	detail::ConfigObjectLoader theLoader( libraryTableInstance(), filePath );
-	RecursiveExpressionPtr expr( RecursiveExpression::create( NULL, name, EVariable ) );
-	BuilderPtr builder = theLoader.getBuilder( *expr );
-	spns::shared_ptr< BuilderT< Runnable > > runnableBuilder;
-	builder_cast( builder, runnableBuilder );
-	
+	detail::LoaderRegistry & registry = detail::loaderRegistry();
+
+	// Binding uses the loader, which is not thread safe, so a kept one is bound under its
+	// lock. One that failed while we waited for it is not used, we get another.
+	detail::LoaderRegistry::Entry entry;
+	std::unique_lock< std::recursive_mutex > lock;
+	do
+	{
+		lock = std::unique_lock< std::recursive_mutex >(); // before what it locks can go
+		entry = registry.loader( filePath );
+		if( entry.m_use )
+		{
+			lock = std::unique_lock< std::recursive_mutex >( entry.m_use->m_lock );
+		}
+	}
+	while( entry.m_use && entry.m_use->m_failed );
+
+	try
+	{
+		RecursiveExpressionPtr expr( RecursiveExpression::create( name, EVariable ) );
+		BuilderPtr builder = entry.m_loader->getBuilder( *expr );
+		spns::shared_ptr< BuilderT< Runnable > > runnableBuilder;
+		builder_cast( builder, runnableBuilder );
+
+		// A constructor, on whichever thread, can get a runnable from the same config, so
+		// the lock is let go before anything is constructed. Each object is still only
+		// constructed once, getObject() sees to that.
+		if( lock.owns_lock() )
+		{
+			lock.unlock();
+		}
+		
+		// everything is bound by now, so objects that don't depend on each other can be
+		// constructed at the same time
+		if( detail::constructionThreads() != 1 )
+		{
+			detail::constructConcurrently( *builder, detail::constructionThreads() );
+		}
 
-	// this next call will actually cause all other objects and values required to get built or resolved
+		// this next call will actually cause all other objects and values required to get built or resolved
 
-	return runnableBuilder->getObject();
+		return runnableBuilder->getObject();
+	}
+	catch( ... )
+	{
+		// whatever failed may be left half bound or built, so a cached loader is not used again
+		if( entry.m_use )
+		{
+			if( !lock.owns_lock() )
+			{
+				lock.lock();
+			}
+			entry.m_use->m_failed = true;
+			registry.evict( filePath, entry.m_loader );
+		}
+		throw;
+	}
+}
+
+void enableLoaderCache()
+{
+	detail::loaderRegistry().enable( true );
+}
+
+void disableLoaderCache()
+{
+	detail::loaderRegistry().enable( false );
+}
+
+void evictLoader( str_cref filePath )
+{
+	detail::loaderRegistry().evict( filePath );
+}
+
+void reloadLoader( str_cref filePath )
+{
+	detail::loaderRegistry().reload( filePath );
+}
+
+void setConfigLayout( ConfigLayout layout )
+{
+	detail::configLayout() = layout;
+}
+
+void setConfigParsing( ConfigParsing parsing )
+{
+	detail::configParsing() = parsing;
+}
+
+void setConstructionThreads( size_t threads )
+{
+	detail::constructionThreads() = threads;
+}
+
+void setLibraryOpening( LibraryOpening opening, size_t threads )
+{
+	detail::libraryOpening().opening = opening;
+	detail::libraryOpening().threads = threads;
 }
 
 ObjectLoaderPtr getObjectLoader( str_cref filePath )
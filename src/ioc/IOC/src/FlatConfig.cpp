@@ -0,0 +1,113 @@
+#include "stdafx.h"
+
+#include "FlatConfig.h"
+#include <deque>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace IOC { namespace detail {
+
+FlatConfig::FlatConfig( std::map< std::string, RecursiveExpressionPtr > & config )
+	: m_arena( new ExpressionArena ), m_exprs( NULL )
+{
+	// number breadth-first so the parameters of each expression are consecutive,
+	// the same way as in a compiled config. Parameters shared by several expressions
+	// are numbered once
+	std::vector< const RecursiveExpression * > nodes;
+	std::unordered_map< const RecursiveExpression *, index_type > numbered;
+	std::deque< size_t > pending;
+	for( std::pair< const std::string, RecursiveExpressionPtr > const& entry : config )
+	{
+		pending.push_back( nodes.size() );
+		nodes.push_back( entry.second.get() );
+	}
+
+	const size_t maxIndex = std::numeric_limits< index_type >::max() - 1;
+	size_t poolSize = 0;
+	m_firstChild.resize( nodes.size() );
+	while( !pending.empty() )
+	{
+		size_t idx = pending.front();
+		pending.pop_front();
+
+		const RecursiveExpression * expr = nodes[idx];
+		ExpressionSpan params = expr->params();
+		m_firstChild[idx] = static_cast< index_type >( nodes.size() );
+		size_t numChildren = params.size();
+		if( numChildren )
+		{
+			std::pair< std::unordered_map< const RecursiveExpression *, index_type >::iterator, bool > res =
+				numbered.insert( std::make_pair( &params.at( 0 ), m_firstChild[idx] ) );
+			if( !res.second )
+			{
+				m_firstChild[idx] = res.first->second;
+				numChildren = 0;
+			}
+		}
+		for( size_t i = 0; i < numChildren; ++i )
+		{
+			m_firstChild.push_back( 0 );
+			pending.push_back( nodes.size() );
+			nodes.push_back( &params.at( i ) );
+		}
+
+		poolSize += expr->value().size();
+		if( nodes.size() > maxIndex || poolSize > maxIndex )
+		{
+			throw std::invalid_argument( "Config is too large to load in flat layout" );
+		}
+	}
+
+	const size_t count = nodes.size();
+	m_types.reserve( count );
+	m_valueOffsets.reserve( count );
+	m_valueSizes.reserve( count );
+	m_numChildren.reserve( count );
+	m_strings.reserve( poolSize );
+
+	for( const RecursiveExpression * expr : nodes )
+	{
+		m_types.push_back( expr->type() );
+		m_valueOffsets.push_back( static_cast< index_type >( m_strings.size() ) );
+		m_valueSizes.push_back( static_cast< index_type >( expr->value().size() ) );
+		m_numChildren.push_back( static_cast< index_type >( expr->params().size() ) );
+		m_strings.append( expr->value() );
+	}
+
+	RecursiveExpression * exprs = m_arena->allocate( count );
+	for( size_t i = 0; i < count; ++i )
+	{
+		// a packed List stays packed, with no entries for its elements
+		if( const LiteralArray * elements = nodes[i]->literals() )
+		{
+			m_arena->set( exprs[i], value( i ), LiteralArray( *elements ) );
+		}
+		else
+		{
+			m_arena->set( exprs[i], value( i ), m_types[i],
+				m_numChildren[i] ? exprs + m_firstChild[i] : NULL, m_numChildren[i] );
+		}
+	}
+	m_exprs = exprs;
+
+	// the roots were numbered first, in the order of the map
+	size_t root = 0;
+	for( std::pair< const std::string, RecursiveExpressionPtr > & entry : config )
+	{
+		entry.second = share( root++ );
+	}
+}
+
+FlatConfig::index_type FlatConfig::indexOf( expr_cref expr ) const
+{
+	std::less< const RecursiveExpression * > before;
+	if( before( &expr, m_exprs ) || !before( &expr, m_exprs + size() ) )
+	{
+		return npos;
+	}
+	return static_cast< index_type >( &expr - m_exprs );
+}
+
+} }
@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef IOC_FLAT_CONFIG_H_
+#define IOC_FLAT_CONFIG_H_
+
+#include <IOC/detail/RecursiveExpression.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace IOC { namespace detail {
+
+// A loaded config copied into parallel arrays, one entry per expression. The
+// parameters of an expression are consecutive entries and values are slices of
+// one string pool, so walking a Concat or a Map reads contiguous memory rather
+// than following pointers.
+//
+// The expressions are also rebuilt to match, in one arena block with the same
+// indices, and the config passed in is changed to refer to those. This is what
+// lets ConfigObjectLoader find the entry for any expression it is given.
+
+class FlatConfig
+{
+public:
+	typedef uint32_t index_type;
+	static const index_type npos = static_cast< index_type >( -1 );
+
+	// throws if the config is too large to index
+	explicit FlatConfig( std::map< std::string, RecursiveExpressionPtr > & config );
+
+	size_t size() const
+	{
+		return m_types.size();
+	}
+
+	ExpressionType type( index_type idx ) const
+	{
+		return m_types[idx];
+	}
+
+	std::string_view value( index_type idx ) const
+	{
+		return std::string_view( m_strings.data() + m_valueOffsets[idx], m_valueSizes[idx] );
+	}
+
+	index_type firstChild( index_type idx ) const
+	{
+		return m_firstChild[idx];
+	}
+
+	index_type numChildren( index_type idx ) const
+	{
+		return m_numChildren[idx];
+	}
+
+	// npos if expr did not come from this config
+	index_type indexOf( expr_cref expr ) const;
+
+	expr_cref expression( index_type idx ) const
+	{
+		return m_exprs[idx];
+	}
+
+	RecursiveExpressionPtr share( index_type idx ) const
+	{
+		return m_arena->share( m_exprs + idx );
+	}
+
+private:
+	std::vector< ExpressionType > m_types;
+	std::vector< index_type > m_valueOffsets;
+	std::vector< index_type > m_valueSizes;
+	std::vector< index_type > m_firstChild;
+	std::vector< index_type > m_numChildren;
+	std::string m_strings;
+
+	spns::shared_ptr< ExpressionArena > m_arena;
+	const RecursiveExpression * m_exprs;
+};
+
+} }
+
+#endif
@@ -0,0 +1,168 @@
+#include "stdafx.h"
+
+#include "LibraryPrefetch.h"
+#include <IOC/Libraries.h>
+#include <IOC/detail/Profiling.h>
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+
+namespace IOC { namespace detail {
+
+LibraryPrefetch::LibraryPrefetch( LibraryTable & libraries, std::vector< Request > const& requests, size_t threads )
+	: m_libraries( libraries ), m_requests( requests ), m_dependents( requests.size() ),
+	m_waitingFor( requests.size(), 0 ), m_states( requests.size(), EWaiting ),
+	m_opened( requests.size(), false ), m_numOpening( 0 )
+{
+	for( size_t idx = 0; idx < m_requests.size(); ++idx )
+	{
+		m_numbered.insert( std::make_pair( m_requests[idx].m_name, idx ) );
+	}
+
+	// one that is not opened here is already open or will be opened when used
+	for( size_t idx = 0; idx < m_requests.size(); ++idx )
+	{
+		for( std::string const& after : m_requests[idx].m_after )
+		{
+			std::map< std::string, size_t >::const_iterator dep = m_numbered.find( after );
+			if( dep != m_numbered.end() )
+			{
+				m_dependents[ dep->second ].push_back( idx );
+				++m_waitingFor[idx];
+			}
+		}
+		if( !m_waitingFor[idx] )
+		{
+			m_states[idx] = EReady;
+			m_ready.push_back( idx );
+		}
+	}
+
+	if( !threads )
+	{
+		threads = std::max( 1u, std::thread::hardware_concurrency() );
+	}
+	threads = std::min( threads, m_requests.size() );
+
+	// If a thread cannot be started those we have open the rest. Throwing here would leave
+	// them unjoined, as the destructor would not run. With none every library is left to be
+	// opened when it is used.
+	for( size_t i = 0; i < threads; ++i )
+	{
+		try
+		{
+			m_threads.emplace_back( [ this ]{ work(); } );
+		}
+		catch( std::system_error const& )
+		{
+			break;
+		}
+	}
+	if( m_threads.empty() )
+	{
+		m_ready.clear();
+	}
+}
+
+LibraryPrefetch::~LibraryPrefetch()
+{
+	for( std::thread & thread : m_threads )
+	{
+		thread.join();
+	}
+}
+
+void LibraryPrefetch::wait( str_cref name ) const
+{
+	std::map< std::string, size_t >::const_iterator found = m_numbered.find( name );
+	if( found == m_numbered.end() )
+	{
+		return;
+	}
+
+	const size_t idx = found->second;
+	std::unique_lock< std::mutex > lock( m_lock );
+	m_changed.wait( lock, [ this, idx ]{ return m_states[idx] == EDone || finished(); } );
+}
+
+void LibraryPrefetch::work()
+{
+	std::unique_lock< std::mutex > lock( m_lock );
+	while( true )
+	{
+		m_changed.wait( lock, [ this ]{ return !m_ready.empty() || !m_numOpening; } );
+		if( m_ready.empty() ) // nothing more can become ready
+		{
+			return;
+		}
+
+		size_t idx = m_ready.front();
+		m_ready.pop_front();
+		m_states[idx] = EOpening;
+		++m_numOpening;
+
+		lock.unlock();
+		open( idx );
+		lock.lock();
+
+		--m_numOpening;
+		m_states[idx] = EDone;
+		for( size_t dependent : m_dependents[idx] )
+		{
+			if( m_opened[idx] )
+			{
+				if( --m_waitingFor[dependent] == 0 && m_states[dependent] == EWaiting )
+				{
+					m_states[dependent] = EReady;
+					m_ready.push_back( dependent );
+				}
+			}
+			else if( m_states[dependent] == EWaiting ) // nor can anything needing it be opened here
+			{
+				m_states[dependent] = EReady;
+				m_ready.push_front( dependent );
+			}
+		}
+		m_changed.notify_all();
+	}
+}
+
+// a library left unopened because of one it needs is passed straight through
+void LibraryPrefetch::open( size_t idx )
+{
+	Request const& request = m_requests[idx];
+	bool ready = true;
+	{
+		std::lock_guard< std::mutex > lock( m_lock );
+		for( std::string const& after : request.m_after )
+		{
+			std::map< std::string, size_t >::const_iterator dep = m_numbered.find( after );
+			ready = ready && ( dep == m_numbered.end() || m_opened[ dep->second ] );
+		}
+	}
+	if( !ready )
+	{
+		return;
+	}
+
+	try
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		{
+			ProfileScope timing( ELibraryLoadPhase, request.m_name );
+			m_libraries.addLibrary( request.m_name, request.m_path );
+		}
+		std::ostringstream oss;
+		oss << "Opened library " << request.m_name << " in " << std::chrono::duration< double, std::milli >(
+			std::chrono::steady_clock::now() - start ).count() << " ms\n";
+		std::clog << oss.str();
+
+		std::lock_guard< std::mutex > lock( m_lock );
+		m_opened[idx] = true;
+	}
+	catch( std::exception const& )
+	{
+	}
+}
+
+} }
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef IOC_LIBRARY_PREFETCH_H_
+#define IOC_LIBRARY_PREFETCH_H_
+
+#include <IOC/iocfwd.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace IOC { namespace detail {
+
+// Opens the libraries a config defines on a pool of threads as soon as it is loaded, so
+// opening them overlaps with parsing and binding, and with each other where the platform
+// allows it. A library is not opened until those it names as needing opening first have
+// been. One that fails to open, or whose dependencies do, is left to be opened when it is
+// used, which reports the error as it always did.
+
+class LibraryPrefetch
+{
+public:
+	struct Request
+	{
+		std::string m_name;
+		std::string m_path;
+		std::vector< std::string > m_after; // the libraries to open first
+	};
+
+	LibraryPrefetch( LibraryTable & libraries, std::vector< Request > const& requests, size_t threads );
+
+	// waits for it to finish
+	~LibraryPrefetch();
+
+	// Waits until the library has been opened or has failed, if it is one being opened here.
+	// If it is never going to be opened, being in a circular dependency, it waits until
+	// everything else is done.
+	void wait( str_cref name ) const;
+
+private:
+	enum State { EWaiting, EReady, EOpening, EDone };
+
+	void work();
+	void open( size_t idx );
+	bool finished() const
+	{
+		return m_ready.empty() && !m_numOpening;
+	}
+
+	LibraryTable & m_libraries;
+	std::vector< Request > m_requests;
+	std::map< std::string, size_t > m_numbered;
+	std::vector< std::vector< size_t > > m_dependents;
+	std::vector< size_t > m_waitingFor;
+
+	mutable std::mutex m_lock;
+	mutable std::condition_variable m_changed;
+	std::vector< State > m_states;
+	std::vector< bool > m_opened;
+	std::deque< size_t > m_ready;
+	size_t m_numOpening;
+	std::vector< std::thread > m_threads;
+
+	LibraryPrefetch( LibraryPrefetch const& ); // not implemented
+	LibraryPrefetch & operator=( LibraryPrefetch const& ); // not implemented
+};
+
+} }
+
+#endif
@@ -2,6 +2,7 @@
 #include <IOC/Libraries.h>
 #include <Utility/mapLookup.h>
 #include <stdexcept>
+#include <mutex>
 
 namespace IOC {
 
@@ -38,6 +39,10 @@ private:
 
 	std::map< std::string, LibraryPtr > m_map;
 
+	// libraries can be opened ahead on other threads while the config is used. The lock
+	// is not held while one is opened, if two threads open the same one the first is kept
+	mutable std::mutex m_lock;
+
 	LibraryPtr & prepare( str_cref name, str_cref path )
 	{
 		LibraryPtr & pLib = m_map[ name ];
@@ -63,20 +68,31 @@ public:
 	// one we try now, we allow it
 	const Library & addLibrary( str_cref name, str_cref path )
 	{
+		{
+			std::lock_guard< std::mutex > lock( m_lock );
+			LibraryPtr & pLib = prepare( name, path );
+			if( pLib )
+			{
+				return *pLib;
+			}
+		}
+
+		// becase this can throw we are slightly overcautious to put it into a 
+		// local variable and only swap it after it has been shown to work.
+		LibraryPtr openLib = openLibrary( name, path );
+
+		std::lock_guard< std::mutex > lock( m_lock );
 		LibraryPtr & pLib = prepare( name, path );
 		if( !pLib )
 		{
-			// becase this can throw we are slightly overcautious to put it into a 
-			// local variable and only swap it after it has been shown to work.
-			LibraryPtr openLib = openLibrary( name, path );
 			openLib.swap( pLib );
-
 		}
 		return *pLib;
 	}
 
 	const Library & addStaticLibrary( str_cref name, LibraryPtr lib )
 	{
+		std::lock_guard< std::mutex > lock( m_lock );
 		LibraryPtr & pLib = prepare( name, lib->getPath() );
 		if( !pLib )
 		{
@@ -87,6 +103,7 @@ public:
 
 	const Library* getLibraryNoThrow( str_cref name ) const
 	{
+		std::lock_guard< std::mutex > lock( m_lock );
 		LibraryPtr pLib;
 		Utility::mapLookup( m_map, name, pLib );
 		return pLib.get();
@@ -12,6 +12,12 @@
 
 namespace {
 
+bool & bindNow()
+{
+	static bool now = false;
+	return now;
+}
+
 }
 
 namespace IOC {
@@ -32,7 +38,7 @@ public:
 		m_alias( alias ),
 		m_path( path )
 	{
-		if( !( m_handle = dlopen( path.c_str(), RTLD_LAZY | RTLD_GLOBAL ) ) )
+		if( !( m_handle = dlopen( path.c_str(), ( bindNow() ? RTLD_NOW : RTLD_LAZY ) | RTLD_GLOBAL ) ) )
 		{
 			std::ostringstream oss;
 			oss << "Failed to open library " << alias
@@ -88,6 +94,11 @@ LibraryPtr openLibrary( str_cref name, str_cref path )
 {
 	return LibraryPtr( new LibraryUnixImpl( name, path ) );
 }
+
+void setLibraryBinding( LibraryBinding binding )
+{
+	bindNow() = binding == EBindOnOpen;
+}
 		
 }
 
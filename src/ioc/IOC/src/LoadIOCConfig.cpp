@@ -1,58 +1,227 @@
 #include "stdafx.h"
 
 #include <IOC/detail/RecursiveExpression.h>
-#include "Utility/mapLookup.h"
-#include <boost/regex.hpp>
+#include <IOC/ioc_api.h>
+#include "MappedFile.h"
+#include "ConfigCache.h"
+#include "UnparsedConfig.h"
 #include <boost/filesystem.hpp>
-#include <set>
-#include <fstream>
+#include <map>
+#include <unordered_map>
+#include <deque>
+#include <string_view>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <thread>
 
 namespace {
 
-std::string trim( std::string const& s )
+// there are other whitespace characters but these
+// are the only ones we trim from the ends of a line
+bool isTrimmable( char ch )
 {
-	// there are other whitespace characters but these
-	// are the only ones we care about
-	const char* whites = " \t\r";
+	return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+// whitespace that may separate the parts of a directive or statement
+bool isSeparator( char ch )
+{
+	return isTrimmable( ch ) || ch == '\n' || ch == '\v' || ch == '\f';
+}
 
-	size_t startPos = s.find_first_not_of( whites );
-	if( startPos != std::string::npos )
+bool isAlpha( char ch )
+{
+	return ( ch >= 'A' && ch <= 'Z' ) || ( ch >= 'a' && ch <= 'z' );
+}
+
+bool isWordChar( char ch )
+{
+	return isAlpha( ch ) || ( ch >= '0' && ch <= '9' ) || ch == '.' || ch == '_';
+}
+
+std::string_view trim( std::string_view s )
+{
+	size_t startPos = 0;
+	size_t endPos = s.size();
+	while( startPos != endPos && isTrimmable( s[startPos] ) )
 	{
-		size_t endPos = s.find_last_not_of( whites );
-		return s.substr( startPos, endPos + 1 - startPos );
+		++startPos;
 	}
-	else
+	while( endPos != startPos && isTrimmable( s[endPos - 1] ) )
+	{
+		--endPos;
+	}
+	return s.substr( startPos, endPos - startPos );
+}
+
+size_t skipSeparators( std::string_view s, size_t pos )
+{
+	while( pos < s.size() && isSeparator( s[pos] ) )
 	{
-		return std::string();
+		++pos;
 	}
+	return pos;
 }
 
-//const char * const sheBangText = "^#[!].*$";
-//const boost::regex sheBangRegex( sheBangText );
+// Everything below was once done with regular expressions, one regex_match per
+// line per pattern. These hand-written scanners accept exactly the same input
+// in a single pass over the text.
+
+// a name begins with a letter followed by letters, digits, . or _
+// returns the position one past its end, which is pos if there is no name there
+size_t scanWord( std::string_view s, size_t pos )
+{
+	if( pos >= s.size() || !isAlpha( s[pos] ) )
+	{
+		return pos;
+	}
+	for( ++pos; pos < s.size() && isWordChar( s[pos] ); ++pos )
+	{
+	}
+	return pos;
+}
+
+// a non-empty quoted string with no embedded quotes that ends the line
+bool matchQuotedToEnd( std::string_view line, size_t pos, std::string_view & text )
+{
+	if( pos >= line.size() || line[pos] != '\"' )
+	{
+		return false;
+	}
+	size_t closePos = line.find( '\"', pos + 1 );
+	if( closePos == std::string_view::npos || closePos == pos + 1 || closePos + 1 != line.size() )
+	{
+		return false;
+	}
+	text = line.substr( pos + 1, closePos - pos - 1 );
+	return true;
+}
+
+// #directive followed by at least one separator. Returns the position after the
+// separators or 0 if the line is not this directive
+size_t matchDirective( std::string_view line, std::string_view directive )
+{
+	if( line.compare( 0, directive.size(), directive ) != 0 )
+	{
+		return 0;
+	}
+	size_t pos = skipSeparators( line, directive.size() );
+	return pos == directive.size() ? 0 : pos;
+}
+
+// #include "path"
+bool matchInclude( std::string_view line, std::string_view & path )
+{
+	size_t pos = matchDirective( line, "#include" );
+	return pos && matchQuotedToEnd( line, pos, path );
+}
+
+// #define SYMBOL "value" where the symbol is purely alphabetic
+bool matchDefine( std::string_view line, std::string_view & sym, std::string_view & value )
+{
+	size_t symPos = matchDirective( line, "#define" );
+	if( !symPos )
+	{
+		return false;
+	}
+
+	size_t symEnd = symPos;
+	while( symEnd < line.size() && isAlpha( line[symEnd] ) )
+	{
+		++symEnd;
+	}
+
+	size_t valuePos = skipSeparators( line, symEnd );
+	if( symEnd == symPos || valuePos == symEnd )
+	{
+		return false;
+	}
+
+	sym = line.substr( symPos, symEnd - symPos );
+	return matchQuotedToEnd( line, valuePos, value );
+}
+
+// key = value;
+// The key is a single word. The value must not be empty (can be "") but can
+// otherwise be anything up to the final ; and will be parsed later. The statement
+// passed in always ends with ;
+bool matchAssignment( std::string_view statement, std::string_view & key, std::string_view & exprText )
+{
+	size_t keyEnd = scanWord( statement, 0 );
+	if( keyEnd == 0 )
+	{
+		return false;
+	}
+
+	size_t equalsPos = skipSeparators( statement, keyEnd );
+	if( equalsPos == statement.size() || statement[equalsPos] != '=' )
+	{
+		return false;
+	}
+
+	size_t lastPos = statement.size() - 1; // the terminating ;
+	size_t exprPos = skipSeparators( statement, equalsPos + 1 );
+	if( exprPos >= lastPos )
+	{
+		// nothing but spaces before the ; The old regex still accepted the last
+		// space as the expression, which then fails to parse with a better message
+		if( equalsPos + 1 >= lastPos )
+		{
+			return false;
+		}
+		exprPos = lastPos - 1;
+	}
 
-const char * const includeRegexText = "^#include\\s+\"([^\"]+)\"$";
-const boost::regex includeRegex( includeRegexText );
+	key = statement.substr( 0, keyEnd );
+	exprText = statement.substr( exprPos, lastPos - exprPos );
+	return true;
+}
 
-const std::string wordRegexText = "[A-Za-z][A-Za-z0-9._]*";
-const boost::regex wordRegex( '^' + wordRegexText + '$' );
+// hands out the lines of a buffer in the manner of std::getline
+class LineReader
+{
+	std::string_view m_text;
+	size_t m_pos;
 
-const std::string equalsRegexText = "^(" + wordRegexText + ")\\s*=\\s*(.+)\\s*;$";
-const boost::regex equalsRegex( equalsRegexText );
+public:
+	explicit LineReader( std::string_view text )
+		: m_text( text ), m_pos( 0 )
+	{
+	}
 
-const char * const defineRegexText = "^#define\\s+([A-Za-z]+)\\s+\"([^\"]+)\"$";
-const boost::regex defineRegex( defineRegexText );
+	bool getLine( std::string_view & line )
+	{
+		if( m_pos == m_text.size() )
+		{
+			return false;
+		}
 
-const char * const envRegexText = "^.*\\$\\(([A-Za-z]+)\\).*$";
-const boost::regex envRegex( envRegexText );
+		size_t endPos = m_text.find( '\n', m_pos );
+		if( endPos == std::string_view::npos )
+		{
+			endPos = m_text.size();
+			line = m_text.substr( m_pos );
+			m_pos = endPos;
+		}
+		else
+		{
+			line = m_text.substr( m_pos, endPos - m_pos );
+			m_pos = endPos + 1;
+		}
+		return true;
+	}
+};
 
 // these words are reserved and cannot be used as user-defined names
-const std::string reservedWordsList[] =
+const std::string_view reservedWordsList[] =
 {
 	"Class", "Concat", "CurrentDir", "Library", "List", 
 	"false", "newline", "quote", "tab", "true", "\x7f\x7f"
 };
 
-bool isReserved( std::string const& str )
+bool isReserved( std::string_view str )
 {
 	return std::binary_search( &reservedWordsList[0], &reservedWordsList[11], str );
 }
@@ -64,13 +233,40 @@ namespace IOC { namespace detail {
 // for a quoted string, unquote it
 
 
+// Loading is done in three steps:
+//  - the files are scanned in order, following #include and #define as we go, and
+//    every key = value; statement is recorded with the text of its value
+//  - the values are parsed. They depend only on their own text and the directory of
+//    their file, not on #define or on each other, so are parsed concurrently
+//  - the parsed statements are added to the config in the order they were read
+// Any error found in the first step is held back until everything read before it
+// has been added, so the error reported is always the one we would have hit had we
+// parsed everything as we read it.
+// Loading lazily, the second step is skipped and the statements are kept as text.
+
 class ConfigLoader
 {
 public:
-	explicit ConfigLoader( std::string const& file )
+	explicit ConfigLoader( std::string const& file, ConfigParsing parsing = EEagerParse )
 	{
-		m_files.insert( file );
-		loadIOCConfig( file );
+		m_files.insert( std::make_pair( file, FileStamp() ) );
+		try
+		{
+			loadIOCConfig( file );
+		}
+		catch( std::invalid_argument const& )
+		{
+			m_scanError = std::current_exception();
+		}
+		if( parsing == EEagerParse )
+		{
+			parseStatements();
+			addStatements();
+		}
+		else
+		{
+			addUnparsed();
+		}
 	}
 
 
@@ -84,11 +280,48 @@ public:
 		return m_config;
 	}
 
+	FileStamps const& files() const
+	{
+		return m_files;
+	}
+
+	std::unordered_map< std::string, std::string > const& defines() const
+	{
+		return m_defines;
+	}
+
+	std::map< std::string, UnparsedValue > & unparsed()
+	{
+		return m_unparsed;
+	}
+
 
 private:
+	// a config file that has been read. Statements refer to its text
+	struct ConfigText
+	{
+		MappedFile m_file;
+		std::string m_path;
+		std::string m_parentPath;
+	};
+
+	// key = value; waiting to be parsed
+	struct Statement
+	{
+		std::string m_key;
+		std::string_view m_exprText;
+		ConfigText const * m_source;
+		RecursiveExpressionPtr m_expr;
+	};
+
 	void loadIOCConfig( std::string const& filePath );
-	bool processStatement( std::istream & is, std::string const& fileName );
+	bool processStatement( LineReader & reader, ConfigText const& source );
+	void parseStatements();
+	void addStatements();
+	void addUnparsed();
 	std::string expandMacros( std::string const& input, std::string const& fileName ) const;
+	void expandMacrosInto( std::string & result, std::string_view text, std::string const& fileName,
+			std::vector< std::string_view > & expanding, std::string & undefined ) const;
 
 	std::string getParentPath( std::string const& fileName ) const
 	{
@@ -102,21 +335,32 @@ private:
 	}
 
 	std::map< std::string, RecursiveExpressionPtr > m_config;
-	std::set< std::string > m_files;
-	std::map< std::string, std::string > m_defines;
+	std::map< std::string, UnparsedValue > m_unparsed;
+	FileStamps m_files;
+	std::unordered_map< std::string, std::string > m_defines;
+
+	// deques because statements refer into these so they must not move
+	std::deque< ConfigText > m_texts;
+	std::deque< std::string > m_joinedLines;
+	std::vector< Statement > m_statements;
+	std::exception_ptr m_scanError;
 };
 
 
-bool ConfigLoader::processStatement( std::istream & is, std::string const& fileName  )
+bool ConfigLoader::processStatement( LineReader & reader, ConfigText const& source )
 {
-	std::string line;
-	std::string readLine;
-	std::string parentPath = getParentPath( fileName );
+	// The statement is a view into the mapped file unless it spans several
+	// lines, in which case they are joined together in lineStore.
+	std::string_view line;
+	std::string lineStore;
+	std::string_view readLine;
+	std::string const& fileName = source.m_path;
+	std::string const& parentPath = source.m_parentPath;
 	size_t lineNum = 0;
 	do
 	{
 		// read a line. 
-		if( !std::getline( is, readLine ) )
+		if( !reader.getLine( readLine ) )
 		{
 			// If we are in the middle of a statement, reaching
 			// end of file is an error. 
@@ -124,7 +368,7 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 			{
 				std::ostringstream oss;
 				oss << "End of file found in " <<
-					fileName.c_str() << " Whilst processing " << line.c_str();
+					fileName.c_str() << " Whilst processing " << line;
 
 				throw std::invalid_argument( oss.str() );
 			}
@@ -134,11 +378,7 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 		++lineNum;
 
 		// trim spaces from the beginning or the end
-		trim( readLine ).swap( readLine );
-
-		// ok we could use some fancy grammar or regex.
-		// anyone who is able to implement that, please go ahead
-		// and do so.
+		readLine = trim( readLine );
 
 		// skip blank lines and comments
 		if( readLine.empty() || readLine[0] == '!' )
@@ -149,8 +389,8 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 			if( !line.empty() )
 			{
 				std::ostringstream oss;
-				oss << "Invalid " << readLine.c_str() << " line " << lineNum <<
-				        " after " << line.c_str();
+				oss << "Invalid " << readLine << " line " << lineNum <<
+				        " after " << line;
 
 				throw std::invalid_argument( oss.str() );
 			}
@@ -161,9 +401,10 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 			// can't set a string to a directory then use a concat to get the
 			// include path
 
-			boost::smatch res;
+			std::string_view incText;
+			std::string_view symText;
+			std::string_view valueText;
 			if( readLine.size() > 1 && readLine[1] == '!' )
-//			if( boost::regex_match( readLine, res, sheBangRegex) )
 			{
                 // this is only allowed on the first line of the file
 			    if( lineNum != 1 )
@@ -182,9 +423,9 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 
 			    continue;
 			}
-			if( boost::regex_match( readLine, res, includeRegex ) )
+			if( matchInclude( readLine, incText ) )
 			{
-				std::string inc = expandMacros( res[1], fileName );
+				std::string inc = expandMacros( std::string( incText ), fileName );
 				
 				// it is a full path if it contains a colon or begins with / (UNC)
 				// For UNIX if it begins ~ it would also be a full path.
@@ -205,18 +446,18 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 					// so using different case you could include the same file
 					// also if you put in a full path that doesn't match
 					// boost's directory string eg swap / or \\  or put in
-					// extra dots the std::set won't see it as a duplicate
+					// extra dots m_files won't see it as a duplicate
 
-				if( m_files.insert( inc ).second )
+				if( m_files.insert( std::make_pair( inc, FileStamp() ) ).second )
 				{
 					loadIOCConfig( inc );
 				}
 				return true;
 			}
-			else if( boost::regex_match( readLine, res, defineRegex ) )
+			else if( matchDefine( readLine, symText, valueText ) )
 			{
-				std::string sym = res[1];
-				std::string value = expandMacros( res[2], fileName );
+				std::string sym( symText );
+				std::string value = expandMacros( std::string( valueText ), fileName );
 
 				if( sym == "CurrentDir" )
 				{
@@ -224,7 +465,7 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 				}
 				else
 				{
-					std::pair< std::map<std::string,std::string>::iterator, bool >
+					std::pair< std::unordered_map<std::string,std::string>::iterator, bool >
 						res = m_defines.insert( std::make_pair( sym, value ) );
 
 					if( !res.second )
@@ -237,39 +478,43 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 			}
 			else
 			{
-				throw std::invalid_argument( "Invalid syntax " + readLine );
+				throw std::invalid_argument( "Invalid syntax " + std::string( readLine ) );
 			}
 		}
+		else if( line.empty() )
+		{
+			line = readLine;
+		}
 		else
 		{
-			line.append( readLine );
+			if( lineStore.empty() )
+			{
+				lineStore.assign( line );
+			}
+			lineStore.append( readLine );
+			line = lineStore;
 		}
 		 // end of switch
 	}
-	while ( line.empty() || *line.rbegin() != ';' );
-	
-	// now we have a line find the first equals sign
-	// essentially this regex should match key = value;
-	// key should be a single word. value must not be empty (can be "")
-	// but can otherwise be anything
+	while ( line.empty() || line.back() != ';' );
 
-	// this is a simple regex for now. (simpler than what it might be)
-	// the right-hand side is .+ i.e. anything but later we will parse
-	// in what is valid for this particular RHS.
-	boost::smatch res;
-	if( boost::regex_match( line, res, equalsRegex ) )
+	// the statement has to outlive this function until it is parsed
+	if( !lineStore.empty() )
+	{
+		m_joinedLines.push_back( std::move( lineStore ) );
+		line = m_joinedLines.back();
+	}
+	
+	// now we have a line split it at the first equals sign into key = value;
+	// the right-hand side is anything but later we will parse in what is valid
+	// for this particular RHS.
+	std::string_view keyText;
+	std::string_view exprText;
+	if( matchAssignment( line, keyText, exprText ) )
 	{
 		// this will be an error if the LHS already exists in this
 		// config (but it can exist in a parent
-		std::string key = res[1];
-		std::string exprText = res[2];
-
-		if( !boost::regex_match( key, res, wordRegex ) )
-		{
-			std::ostringstream oss;
-			oss << "Valid characters in names are alpha-numeric . and _ and must begin with alphabetic";
-			throw std::invalid_argument( oss.str() );
-		}
+		std::string key( keyText );
 
 		// now check it isn't reserved
 		if( isReserved( key ) )
@@ -279,13 +524,139 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 			throw std::invalid_argument( oss.str() );
 		}
 
-		// parse in the expression and check it parses correctly. If it doesn't,
-		// it will come with an EError type.
-		RecursiveExpressionPtr expr = RecursiveExpression::parse( exprText, parentPath );
+		// the expression is parsed later along with all the others
+		Statement statement;
+		statement.m_key.swap( key );
+		statement.m_exprText = exprText;
+		statement.m_source = &source;
+		m_statements.push_back( std::move( statement ) );
+
+		return true;
+	}
+	else
+	{
+		throw std::invalid_argument( "Invalid syntax: " + std::string( line ) );
+	}
+}
+
+
+// we'll refactor as we go along
+void ConfigLoader::loadIOCConfig( std::string const& filePath )
+{
+	// our current level of config is the one we are currently on
+	std::cerr << "Loading config file " << filePath << '\n';
+	m_texts.emplace_back();
+	ConfigText & source = m_texts.back();
+
+	// stamped with the text we parse, and the time from before we read it, so a change
+	// made while we do is not taken for what we read
+	FileStamp & stamp = m_files[ filePath ];
+	stampTime( filePath, stamp );
+	if( !source.m_file.open( filePath ) )
+	{
+		throw std::invalid_argument( "Failed to open config file " + filePath );
+	}
+	else
+	{
+		stampText( source.m_file.text(), stamp );
+
+		// statements are scanned straight out of the mapped file, which stays
+		// mapped until the loader is done with them
+		source.m_path = filePath;
+		source.m_parentPath = getParentPath( filePath );
+		LineReader reader( source.m_file.text() );
+		while( processStatement( reader, source ) );
+	}
+}
+
+void ConfigLoader::parseStatements()
+{
+	// Statements are handed out in batches to a thread per core. Small configs
+	// are not worth starting threads for and are parsed in one batch here.
+	const size_t batchSize = 256;
+	const size_t numBatches = ( m_statements.size() + batchSize - 1 ) / batchSize;
+	const size_t numThreads = std::min< size_t >( numBatches,
+			std::max( 1u, std::thread::hardware_concurrency() ) );
+
+	std::atomic< size_t > nextBatch( 0 );
+	std::atomic< size_t > numShared( 0 );
+	std::atomic< size_t > sharedSize( 0 );
+	std::vector< std::exception_ptr > errors( numThreads );
+	auto parseBatches = [ this, &nextBatch, numBatches, &numShared, &sharedSize, &errors ]( size_t threadNum )
+	{
+		try
+		{
+			// each thread allocates its expressions in an arena of its own
+			spns::shared_ptr< ExpressionArena > arena( new ExpressionArena );
+			for( size_t batch; ( batch = nextBatch++ ) < numBatches; )
+			{
+				size_t end = std::min( ( batch + 1 ) * batchSize, m_statements.size() );
+				for( size_t i = batch * batchSize; i < end; ++i )
+				{
+					Statement & statement = m_statements[i];
+					statement.m_expr = RecursiveExpression::parse( statement.m_exprText,
+							statement.m_source->m_parentPath, *arena );
+				}
+			}
+			numShared += arena->numShared();
+			sharedSize += arena->sharedSize();
+			arena->clearShared();
+		}
+		catch( ... ) // parse reports errors in the expression so this is only out of memory
+		{
+			errors[ threadNum ] = std::current_exception();
+		}
+	};
+
+	// Batches are taken as each thread is ready for one, so if we cannot start a thread
+	// those it would have parsed are parsed by the ones we have, including this one
+	std::vector< std::thread > threads;
+	for( size_t threadNum = 1; threadNum < numThreads; ++threadNum )
+	{
+		try
+		{
+			threads.emplace_back( parseBatches, threadNum );
+		}
+		catch( std::system_error const& )
+		{
+			break;
+		}
+	}
+	if( numThreads )
+	{
+		parseBatches( 0 );
+	}
+	for( std::thread & thread : threads )
+	{
+		thread.join();
+	}
+
+	for( std::exception_ptr const& error : errors )
+	{
+		if( error )
+		{
+			std::rethrow_exception( error );
+		}
+	}
+
+	if( numShared )
+	{
+		std::cerr << "Shared " << numShared << " repeated sub-expressions, saving "
+			<< sharedSize << " expressions\n";
+	}
+}
+
+void ConfigLoader::addStatements()
+{
+	for( Statement const& statement : m_statements )
+	{
+		// check the expression parsed correctly. If it didn't it will have an EError type.
+		RecursiveExpressionPtr const& expr = statement.m_expr;
 		if( expr->type() == EError )
 		{
 			std::ostringstream oss;
-			oss << expr->value() << "\n\tdefining " << key << " in file " << fileName;
+			oss << expr->value() << "\n\tdefining " << statement.m_key << " in file "
+				<< statement.m_source->m_path;
 			throw std::invalid_argument( oss.str() );
 		}
 
@@ -295,82 +666,166 @@ bool ConfigLoader::processStatement( std::istream & is, std::string const& fileN
 		// only used as a parametered expression.
 
 		std::pair<std::map<std::string, RecursiveExpressionPtr>::iterator, bool> res =
-			m_config.insert( std::make_pair( key, expr ) );
+			m_config.insert( std::make_pair( statement.m_key, expr ) );
 
 		if( !res.second )
 		{
 			std::ostringstream oss;
-			oss << "Redefinition of " << key << " previously defined to be " << expr->value();
+			oss << "Redefinition of " << statement.m_key << " previously defined to be " << expr->value();
 			throw std::invalid_argument( oss.str() );
 		}
-
-		return true;
 	}
-	else
+
+	// if reading stopped early, this is where we got to
+	if( m_scanError )
 	{
-		throw std::invalid_argument( "Invalid syntax: " + line );
+		std::rethrow_exception( m_scanError );
 	}
 }
 
-
-// we'll refactor as we go along
-void ConfigLoader::loadIOCConfig( std::string const& filePath )
+// Only the names are checked. A redefinition is reported as addStatements() would,
+// which needs the value parsed, but that is only done when there is one.
+void ConfigLoader::addUnparsed()
 {
-	// our current level of config is the one we are currently on
-	boost::filesystem::path path( filePath );
-	std::cerr << "Loading config file " << filePath << '\n';
-	std::ifstream ifs( filePath.c_str() );
-	if( !ifs )
+	for( Statement & statement : m_statements )
 	{
-		throw std::invalid_argument( "Failed to open config file " + filePath );
+		ConfigText const& source = *statement.m_source;
+		UnparsedValue value = { statement.m_exprText, &source.m_path, &source.m_parentPath };
+		if( m_unparsed.try_emplace( std::move( statement.m_key ), value ).second )
+		{
+			continue;
+		}
+
+		// try_emplace has left the key alone
+		RecursiveExpressionPtr expr = RecursiveExpression::parse( statement.m_exprText, source.m_parentPath );
+		std::ostringstream oss;
+		if( expr->type() == EError )
+		{
+			oss << expr->value() << "\n\tdefining " << statement.m_key << " in file " << source.m_path;
+		}
+		else
+		{
+			oss << "Redefinition of " << statement.m_key << " previously defined to be " << expr->value();
+		}
+		throw std::invalid_argument( oss.str() );
 	}
-	else
+	std::vector< Statement >().swap( m_statements );
+
+	if( m_scanError )
 	{
-		while( processStatement( ifs, filePath ) );
+		std::rethrow_exception( m_scanError );
 	}
 }
 
+// Every $(SYMBOL) is replaced by its #define value in a single pass. As before, what
+// it is replaced with is expanded too. It is an error to refer to an undefined symbol,
+// and we report the last one in the input, which is the one the old regex found.
 std::string ConfigLoader::expandMacros( std::string const& input, std::string const& fileName ) const
 {
-	std::string parsed = input;
-	bool matched = true;
-	do
+	std::string expanded;
+	expanded.reserve( input.size() );
+
+	std::vector< std::string_view > expanding;
+	std::string undefined;
+	expandMacrosInto( expanded, input, fileName, expanding, undefined );
+	if( !undefined.empty() )
+	{
+		std::ostringstream oss;
+		oss << "Undefined macro " << undefined << " in " << input << " file " << fileName;
+		throw std::invalid_argument( oss.str() );
+	}
+
+	return expanded;
+}
+
+// expanding holds the symbols whose values we are part way through, so that a
+// value which expands back to itself is caught rather than looping forever
+void ConfigLoader::expandMacrosInto( std::string & result, std::string_view text, std::string const& fileName,
+		std::vector< std::string_view > & expanding, std::string & undefined ) const
+{
+	size_t pos = 0;
+	for( size_t start; ( start = text.find( "$(", pos ) ) != std::string_view::npos; )
 	{
-		boost::smatch res;
-		if( boost::regex_match( parsed, res, envRegex ) )
+		size_t symPos = start + 2;
+		size_t symEnd = symPos;
+		while( symEnd < text.size() && isAlpha( text[symEnd] ) )
 		{
-			std::string sym = res[1];
-			std::string find = "$(" + sym + ")";
+			++symEnd;
+		}
 
-			std::string replace;
-			if( sym == "CurrentDir" )
-			{
-				replace = getParentPath( fileName );
-			}
-			else if(! Utility::mapLookup( m_defines, sym, replace ) )
-			{
-				std::ostringstream oss;
-				oss << "Undefined macro " << sym << " in " << input << " file " << fileName;
-				throw std::invalid_argument( oss.str() );
-			}
-            std::string::size_type pos = parsed.find( find );
-            parsed = parsed.substr( 0, pos ) + replace + parsed.substr( pos + sym.size() + 3 );
-			matched = true;
+		if( symEnd == symPos || symEnd == text.size() || text[symEnd] != ')' )
+		{
+			// not a macro, leave it as it is
+			result.append( text, pos, symPos - pos );
+			pos = symPos;
+			continue;
+		}
+
+		result.append( text, pos, start - pos );
+		pos = symEnd + 1;
+		std::string_view sym = text.substr( symPos, symEnd - symPos );
+
+		if( std::find( expanding.begin(), expanding.end(), sym ) != expanding.end() )
+		{
+			std::ostringstream oss;
+			oss << "Macro " << sym << " refers to itself in " << text << " file " << fileName;
+			throw std::invalid_argument( oss.str() );
+		}
+
+		std::string parentPath;
+		std::string const * value = &parentPath;
+		if( sym == "CurrentDir" )
+		{
+			parentPath = getParentPath( fileName );
 		}
 		else
 		{
-			matched = false;
+			std::unordered_map< std::string, std::string >::const_iterator iter =
+				m_defines.find( std::string( sym ) );
+
+			if( iter == m_defines.end() )
+			{
+				undefined.assign( sym );
+				continue;
+			}
+			value = &iter->second;
 		}
+
+		expanding.push_back( sym );
+		expandMacrosInto( result, *value, fileName, expanding, undefined );
+		expanding.pop_back();
 	}
-	while( matched );
 
-	return parsed;
+	result.append( text, pos );
 }
 
-void loadIOCConfigInto( str_cref filePath, std::map< std::string, RecursiveExpressionPtr > & config )
+void loadIOCConfigInto( str_cref filePath, std::map< std::string, RecursiveExpressionPtr > & config,
+		FileStamps & files )
 {
+	std::string cachePath = configCachePath( filePath );
+	if( !cachePath.empty() && readConfigCache( cachePath, filePath, config, files ) )
+	{
+		return;
+	}
+
 	ConfigLoader loader( filePath );
 	config.swap( loader.config() );
+	files = loader.files();
+
+	if( !cachePath.empty() )
+	{
+		writeConfigCache( cachePath, filePath, loader.files(), loader.defines(), config );
+	}
+}
+
+// nothing is parsed so there is nothing to cache
+spns::shared_ptr< ConfigLoader > loadIOCConfigUnparsed( str_cref filePath,
+		std::map< std::string, UnparsedValue > & values, FileStamps & files )
+{
+	spns::shared_ptr< ConfigLoader > loader( new ConfigLoader( filePath, ELazyParse ) );
+	values.swap( loader->unparsed() );
+	files = loader->files();
+	return loader;
 }
 
 
@@ -0,0 +1,71 @@
+#pragma once
+
+#ifndef IOC_MAPPED_FILE_H_
+#define IOC_MAPPED_FILE_H_
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/filesystem.hpp>
+#include <string>
+#include <string_view>
+
+namespace IOC { namespace detail {
+
+// A whole file mapped read-only into memory. Anything taken from text()
+// is only valid for as long as this object lives.
+//
+// We use boost::interprocess rather than mmap directly so this works on
+// Windows too.
+
+class MappedFile
+{
+	boost::interprocess::file_mapping m_mapping;
+	boost::interprocess::mapped_region m_region;
+
+public:
+	MappedFile()
+	{
+	}
+
+	// does not throw if the file cannot be opened, it returns false so
+	// the caller can report it with its own context
+	bool open( std::string const& filePath )
+	{
+		namespace bip = boost::interprocess;
+
+		boost::system::error_code err;
+		boost::uintmax_t size = boost::filesystem::file_size( filePath, err );
+		if( err )
+		{
+			return false;
+		}
+
+		try
+		{
+			bip::file_mapping mapping( filePath.c_str(), bip::read_only );
+
+			// an empty file cannot be mapped but is still a valid (empty) file
+			if( size != 0 )
+			{
+				bip::mapped_region region( mapping, bip::read_only );
+				m_region.swap( region );
+			}
+			m_mapping.swap( mapping );
+		}
+		catch( bip::interprocess_exception const& )
+		{
+			return false;
+		}
+		return true;
+	}
+
+	std::string_view text() const
+	{
+		return std::string_view( static_cast< const char * >( m_region.get_address() ),
+				m_region.get_size() );
+	}
+};
+
+} }
+
+#endif
@@ -0,0 +1,391 @@
+#include "stdafx.h"
+
+#include <IOC/detail/Profiling.h>
+#include <IOC/Builder.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace IOC { namespace detail {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char * const phaseNames[] = { "parse", "library_load", "symbol_lookup", "bind", "construct" };
+const size_t numPhases = sizeof( phaseNames ) / sizeof( phaseNames[0] );
+
+struct ProfileEvent
+{
+	ProfilePhase m_phase;
+	std::string m_name;
+	size_t m_thread;
+	size_t m_parent; // the event open on the same thread when this one began
+	long long m_start; // nanoseconds since profiling was enabled
+	long long m_end; // -1 while open
+	long long m_childTime; // time in the events directly inside this one
+
+	// Construction only. What it is made from, as builders while it is open then as their
+	// events. If its builder does not know them they are those constructed inside it
+	const Builder * m_builder;
+	bool m_depsKnown;
+	std::vector< const Builder * > m_depBuilders;
+	std::vector< size_t > m_deps;
+
+	long long inclusive() const
+	{
+		return m_end - m_start;
+	}
+
+	long long exclusive() const
+	{
+		return m_end - m_start - m_childTime;
+	}
+};
+
+struct Profile
+{
+	std::atomic< bool > m_enabled;
+	std::mutex m_lock;
+	size_t m_generation; // so threads forget events from before it was last enabled
+	Clock::time_point m_origin;
+	size_t m_numThreads;
+	std::vector< ProfileEvent > m_events;
+	std::unordered_map< const Builder *, size_t > m_constructed; // each builder's latest construction
+
+	Profile()
+		: m_enabled( false ), m_generation( 0 ), m_numThreads( 0 )
+	{
+	}
+
+	long long now() const
+	{
+		return std::chrono::duration_cast< std::chrono::nanoseconds >( Clock::now() - m_origin ).count();
+	}
+};
+
+Profile & profile()
+{
+	static Profile theProfile;
+	return theProfile;
+}
+
+struct ProfileThread
+{
+	size_t m_generation;
+	size_t m_thread;
+	size_t m_open; // innermost open event
+
+	ProfileThread()
+		: m_generation( 0 ), m_thread( 0 ), m_open( ProfileScope::npos )
+	{
+	}
+};
+
+// must be called with the profile locked
+ProfileThread & profileThread( Profile & prof )
+{
+	static thread_local ProfileThread thread;
+	if( thread.m_generation != prof.m_generation )
+	{
+		thread.m_generation = prof.m_generation;
+		thread.m_thread = prof.m_numThreads++;
+		thread.m_open = ProfileScope::npos;
+	}
+	return thread;
+}
+
+std::vector< ProfileEvent > finishedEvents()
+{
+	Profile & prof = profile();
+	std::lock_guard< std::mutex > lock( prof.m_lock );
+	std::vector< ProfileEvent > events( prof.m_events );
+	for( ProfileEvent & event : events )
+	{
+		if( event.m_end < 0 ) // still open, so it has taken until now
+		{
+			event.m_end = prof.now();
+		}
+	}
+	return events;
+}
+
+void writeString( std::ostream & os, std::string const& str )
+{
+	os << '"';
+	for( char ch : str )
+	{
+		if( ch == '"' || ch == '\\' )
+		{
+			os << '\\' << ch;
+		}
+		else if( static_cast< unsigned char >( ch ) < 0x20 )
+		{
+			os << "\\u" << std::hex << std::setw( 4 ) << std::setfill( '0' ) << int( ch ) << std::dec;
+		}
+		else
+		{
+			os << ch;
+		}
+	}
+	os << '"';
+}
+
+double toMs( long long ns )
+{
+	return ns / 1e6;
+}
+
+struct ObjectTimes
+{
+	size_t m_count;
+	long long m_bind;
+	long long m_bindExclusive;
+	long long m_construct;
+	long long m_constructExclusive;
+
+	ObjectTimes()
+		: m_count( 0 ), m_bind( 0 ), m_bindExclusive( 0 ), m_construct( 0 ), m_constructExclusive( 0 )
+	{
+	}
+};
+
+bool slowerConstruction( std::pair< std::string, ObjectTimes > const& lhs,
+	std::pair< std::string, ObjectTimes > const& rhs )
+{
+	if( lhs.second.m_constructExclusive != rhs.second.m_constructExclusive )
+	{
+		return lhs.second.m_constructExclusive > rhs.second.m_constructExclusive;
+	}
+	return lhs.second.m_bindExclusive > rhs.second.m_bindExclusive;
+}
+
+// The chain of constructions, each made from the next, whose exclusive times add up to the
+// most. However many threads construct them they cannot be done any quicker than that
+std::vector< size_t > criticalPath( std::vector< ProfileEvent > const& events, long long & length )
+{
+	// anything is made from what was finished before it
+	std::vector< size_t > order;
+	for( size_t idx = 0; idx < events.size(); ++idx )
+	{
+		if( events[idx].m_phase == EConstructPhase )
+		{
+			order.push_back( idx );
+		}
+	}
+	std::stable_sort( order.begin(), order.end(), [ &events ]( size_t lhs, size_t rhs )
+		{ return events[lhs].m_end < events[rhs].m_end; } );
+
+	std::vector< long long > cost( events.size(), 0 );
+	std::vector< size_t > next( events.size(), ProfileScope::npos );
+	size_t longest = ProfileScope::npos;
+	for( size_t idx : order )
+	{
+		for( size_t dep : events[idx].m_deps )
+		{
+			if( next[idx] == ProfileScope::npos || cost[dep] > cost[ next[idx] ] )
+			{
+				next[idx] = dep;
+			}
+		}
+		cost[idx] = events[idx].exclusive() + ( next[idx] == ProfileScope::npos ? 0 : cost[ next[idx] ] );
+		if( longest == ProfileScope::npos || cost[idx] > cost[longest] )
+		{
+			longest = idx;
+		}
+	}
+
+	std::vector< size_t > path;
+	length = longest == ProfileScope::npos ? 0 : cost[longest];
+	for( size_t idx = longest; idx != ProfileScope::npos; idx = next[idx] )
+	{
+		path.push_back( idx );
+	}
+	return path;
+}
+
+}
+
+const size_t ProfileScope::npos;
+
+bool ProfileScope::profiling()
+{
+	return profile().m_enabled.load( std::memory_order_relaxed );
+}
+
+size_t ProfileScope::begin( ProfilePhase phase, str_cref name, const Builder * builder )
+{
+	ProfileEvent event;
+	event.m_phase = phase;
+	event.m_name = !builder ? name : builder->alias().empty() ? builder->type() : builder->alias();
+	event.m_parent = npos;
+	event.m_end = -1;
+	event.m_childTime = 0;
+	event.m_builder = phase == EConstructPhase ? builder : NULL;
+	event.m_depsKnown = event.m_builder && builder->dependencies( event.m_depBuilders );
+	event.m_deps.reserve( event.m_depBuilders.size() );
+
+	Profile & prof = profile();
+	std::lock_guard< std::mutex > lock( prof.m_lock );
+	ProfileThread & thread = profileThread( prof );
+	event.m_thread = thread.m_thread;
+	event.m_parent = thread.m_open;
+	event.m_start = prof.now();
+
+	thread.m_open = prof.m_events.size();
+	prof.m_events.push_back( std::move( event ) );
+	return thread.m_open;
+}
+
+void ProfileScope::end( size_t idx )
+{
+	Profile & prof = profile();
+	std::lock_guard< std::mutex > lock( prof.m_lock );
+	ProfileThread & thread = profileThread( prof );
+	if( idx >= prof.m_events.size() || thread.m_open != idx ) // enabled again since it began
+	{
+		return;
+	}
+
+	ProfileEvent & event = prof.m_events[idx];
+	event.m_end = prof.now();
+	thread.m_open = event.m_parent;
+	if( event.m_parent != npos )
+	{
+		ProfileEvent & parent = prof.m_events[ event.m_parent ];
+		parent.m_childTime += event.inclusive();
+		if( event.m_phase == EConstructPhase && parent.m_phase == EConstructPhase && !parent.m_depsKnown )
+		{
+			parent.m_deps.push_back( idx );
+		}
+	}
+
+	if( event.m_builder )
+	{
+		// everything it is made from has been constructed by now, whichever thread did it
+		for( const Builder * dep : event.m_depBuilders )
+		{
+			std::unordered_map< const Builder *, size_t >::const_iterator found = prof.m_constructed.find( dep );
+			if( found != prof.m_constructed.end() && prof.m_events[ found->second ].m_end >= 0 )
+			{
+				event.m_deps.push_back( found->second );
+			}
+		}
+		prof.m_constructed[ event.m_builder ] = idx;
+	}
+}
+
+} // close namespace detail
+
+void enableProfiling()
+{
+	detail::Profile & prof = detail::profile();
+	std::lock_guard< std::mutex > lock( prof.m_lock );
+	++prof.m_generation;
+	prof.m_numThreads = 0;
+	prof.m_events.clear();
+	prof.m_constructed.clear();
+	prof.m_origin = detail::Clock::now();
+	prof.m_enabled = true;
+}
+
+void disableProfiling()
+{
+	detail::profile().m_enabled = false;
+}
+
+void writeProfile( std::ostream & os )
+{
+	using namespace detail;
+
+	std::vector< ProfileEvent > events = finishedEvents();
+
+	size_t phaseCounts[ numPhases ] = {};
+	long long phaseTimes[ numPhases ] = {};
+	std::map< std::string, ObjectTimes > objects;
+	for( ProfileEvent const& event : events )
+	{
+		++phaseCounts[ event.m_phase ];
+		phaseTimes[ event.m_phase ] += event.exclusive();
+		if( event.m_phase == EBindPhase )
+		{
+			ObjectTimes & times = objects[ event.m_name ];
+			times.m_bind += event.inclusive();
+			times.m_bindExclusive += event.exclusive();
+		}
+		else if( event.m_phase == EConstructPhase )
+		{
+			ObjectTimes & times = objects[ event.m_name ];
+			++times.m_count;
+			times.m_construct += event.inclusive();
+			times.m_constructExclusive += event.exclusive();
+		}
+	}
+	std::vector< std::pair< std::string, ObjectTimes > > slowest( objects.begin(), objects.end() );
+	std::stable_sort( slowest.begin(), slowest.end(), slowerConstruction );
+
+	long long pathLength;
+	std::vector< size_t > path = criticalPath( events, pathLength );
+
+	// written in full first so the caller's stream settings are left alone
+	std::ostringstream oss;
+	oss << std::fixed << std::setprecision( 3 );
+	oss << "{\n\t\"phases\": [";
+	for( size_t phase = 0; phase < numPhases; ++phase )
+	{
+		oss << ( phase ? "," : "" ) << "\n\t\t{ \"phase\": \"" << phaseNames[phase] << "\", \"count\": "
+			<< phaseCounts[phase] << ", \"exclusive_ms\": " << toMs( phaseTimes[phase] ) << " }";
+	}
+
+	oss << "\n\t],\n\t\"objects\": [";
+	for( size_t i = 0; i < slowest.size(); ++i )
+	{
+		ObjectTimes const& times = slowest[i].second;
+		oss << ( i ? "," : "" ) << "\n\t\t{ \"name\": ";
+		writeString( oss, slowest[i].first );
+		oss << ", \"count\": " << times.m_count
+			<< ", \"bind_ms\": " << toMs( times.m_bind )
+			<< ", \"bind_exclusive_ms\": " << toMs( times.m_bindExclusive )
+			<< ", \"construct_ms\": " << toMs( times.m_construct )
+			<< ", \"construct_exclusive_ms\": " << toMs( times.m_constructExclusive ) << " }";
+	}
+
+	oss << "\n\t],\n\t\"critical_path\": {\n\t\t\"ms\": " << toMs( pathLength ) << ",\n\t\t\"objects\": [";
+	for( size_t i = 0; i < path.size(); ++i )
+	{
+		oss << ( i ? ", " : " " );
+		writeString( oss, events[ path[i] ].m_name );
+	}
+	oss << ( path.empty() ? "]" : " ]" ) << "\n\t}\n}\n";
+
+	os << oss.str();
+}
+
+void writeProfileTrace( std::ostream & os )
+{
+	using namespace detail;
+
+	std::vector< ProfileEvent > events = finishedEvents();
+
+	std::ostringstream oss;
+	oss << std::fixed << std::setprecision( 3 );
+	oss << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	for( size_t i = 0; i < events.size(); ++i )
+	{
+		ProfileEvent const& event = events[i];
+		oss << ( i ? "," : "" ) << "\n{\"name\": ";
+		writeString( oss, event.m_name );
+		oss << ", \"cat\": \"" << phaseNames[ event.m_phase ] << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+			<< event.m_thread << ", \"ts\": " << event.m_start / 1e3 << ", \"dur\": " << event.inclusive() / 1e3
+			<< ", \"args\": {\"exclusive_ms\": " << toMs( event.exclusive() ) << "}}";
+	}
+	oss << "\n]}\n";
+
+	os << oss.str();
+}
+
+}
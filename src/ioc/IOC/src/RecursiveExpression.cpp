@@ -1,11 +1,16 @@
 #include "stdafx.h"
 
 #include <IOC/detail/RecursiveExpression.h>
+#include "SymbolTable.h"
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <functional>
+#include <limits>
 
 namespace {
-	typedef std::string::const_iterator iter_type;
+	typedef std::string_view::const_iterator iter_type;
 	typedef std::pair< std::string, IOC::ExpressionType > TokenData;
 	const TokenData tkdInit( std::string(), IOC::EError );
 
@@ -27,44 +32,341 @@ bool skipWhitespace( iter_type & iter, iter_type end )
 namespace IOC {
 
 
-RecursiveExpression::RecursiveExpression( RecursiveExpression * parent, std::string const& value, Type type )
-	: m_value( value ), m_type( type ), m_parent( parent )
+namespace {
+	const std::string noValue;
+
+	bool isLiteral( IOC::ExpressionType type )
+	{
+		return type == IOC::EString || type == IOC::EInt || type == IOC::EReal || type == IOC::EError;
+	}
+
+	bool hasLiteralValue( IOC::ExpressionType type )
+	{
+		return type == IOC::EInt || type == IOC::EReal || type == IOC::EBool;
+	}
+
+	// returns false if the text is not a valid value of the type. Numbers may
+	// have a leading + as they always could
+	bool decodeLiteral( std::string_view text, IOC::ExpressionType type, IOC::LiteralValue & literal )
+	{
+		if( type == IOC::EBool )
+		{
+			literal.m_bool = ( text == "true" );
+			return literal.m_bool || text == "false";
+		}
+
+		const char * first = text.data();
+		const char * last = first + text.size();
+		if( first != last && *first == '+' )
+		{
+			++first;
+			if( first != last && *first == '-' )
+			{
+				return false;
+			}
+		}
+
+		std::from_chars_result res;
+		if( type == IOC::EInt )
+		{
+			res = std::from_chars( first, last, literal.m_int );
+		}
+		else
+		{
+			res = std::from_chars( first, last, literal.m_real );
+		}
+		return res.ec == std::errc() && res.ptr == last;
+	}
+
+	size_t combineHash( size_t seed, size_t hash )
+	{
+		return seed ^ ( hash + 0x9e3779b9 + ( seed << 6 ) + ( seed >> 2 ) );
+	}
+}
+
+RecursiveExpression::RecursiveExpression()
+	: m_value( &noValue ), m_params( NULL ), m_numParams( 0 ), m_type( EError ), m_link( ENotLinked ),
+	m_packed( false ), m_folded( false ), m_arena( NULL )
+{
+}
+
+void RecursiveExpression::link( LinkState state, const RecursiveExpression * target, std::string const& name )
+{
+	if( m_type != EVariable )
+	{
+		std::ostringstream oss;
+		oss << "Cannot link " << value() << " as it is not a variable";
+		throw std::logic_error( oss.str() );
+	}
+	m_link = static_cast< uint8_t >( state );
+	m_target = target;
+	m_targetName = &name;
+}
+
+void RecursiveExpression::fold( std::string && value )
 {
+	if( m_type != EConcat )
+	{
+		std::ostringstream oss;
+		oss << "Cannot fold " << this->value() << " as it is not a Concat";
+		throw std::logic_error( oss.str() );
+	}
+	m_arena->fold( *this, std::move( value ) );
 }
 
-void RecursiveExpression::setError( std::string const& value )
+RecursiveExpressionPtr RecursiveExpression::create( std::string const& value, Type type )
 {
-	m_type = EError;
-	m_value = value;
+	spns::shared_ptr< ExpressionArena > arena( new ExpressionArena );
+	RecursiveExpression * expr = arena->allocate( 1 );
+	arena->set( *expr, value, type, NULL, 0 );
+	return arena->share( expr );
 }
 
-void RecursiveExpression::addToParent()
+RecursiveExpressionPtr RecursiveExpression::create() 
 {
-	m_parent->m_params.push_back( RecursiveExpressionPtr( this ) );
+	return create( "Expression is empty", EError );
 }
 
+ExpressionArena::ExpressionArena()
+	: m_blockUsed( 0 ), m_blockCapacity( 0 ), m_size( 0 ), m_names( new detail::SymbolTable ),
+	m_numShared( 0 ), m_sharedSize( 0 )
+{
+}
 
-RecursiveExpression * RecursiveExpression::create( RecursiveExpression * parent, std::string const& value, Type type )
+ExpressionArena::~ExpressionArena()
 {
-	RecursiveExpression * rec = new RecursiveExpression( parent, value, type );
-	if( parent )
+	for( RecursiveExpression * block : m_blocks )
 	{
-		rec->addToParent();
+		delete [] block;
 	}
-	return rec;
 }
 
-RecursiveExpression * RecursiveExpression::create() 
+RecursiveExpression * ExpressionArena::allocate( size_t count )
 {
-	return create( NULL, "Expression is empty", EError );
+	// blocks start small so a single parsed expression does not take much, and double
+	// up to a limit. Anything that does not fit gets a block to itself
+	const size_t firstBlock = 16;
+	const size_t maxBlock = 4096;
+
+	if( m_blocks.empty() || m_blockCapacity - m_blockUsed < count )
+	{
+		size_t capacity = m_blockCapacity ? std::min( m_blockCapacity * 2, maxBlock ) : firstBlock;
+		if( capacity < count )
+		{
+			capacity = count;
+		}
+		m_blocks.push_back( new RecursiveExpression[ capacity ] );
+		m_blockCapacity = capacity;
+		m_blockUsed = 0;
+	}
+
+	RecursiveExpression * res = m_blocks.back() + m_blockUsed;
+	m_blockUsed += count;
+	m_size += count;
+	return res;
 }
 
+void ExpressionArena::set( RecursiveExpression & expr, std::string_view value, ExpressionType type,
+		const RecursiveExpression * params, size_t numParams )
+{
+	if( isLiteral( type ) )
+	{
+		m_literals.emplace_back( value );
+		link( expr, m_literals.back(), type, params, numParams );
+	}
+	else
+	{
+		link( expr, m_names->str( m_names->intern( value ) ), type, params, numParams );
+	}
+}
 
+void ExpressionArena::set( RecursiveExpression & expr, std::string && value, ExpressionType type,
+		const RecursiveExpression * params, size_t numParams )
+{
+	if( isLiteral( type ) )
+	{
+		m_literals.push_back( std::move( value ) );
+		link( expr, m_literals.back(), type, params, numParams );
+	}
+	else
+	{
+		set( expr, std::string_view( value ), type, params, numParams );
+	}
+}
+
+void ExpressionArena::set( RecursiveExpression & expr, std::string && value, ExpressionType type,
+		LiteralValue literal )
+{
+	if( isLiteral( type ) )
+	{
+		m_literals.push_back( std::move( value ) );
+		link( expr, m_literals.back(), type, literal );
+	}
+	else
+	{
+		link( expr, m_names->str( m_names->intern( std::string_view( value ) ) ), type, literal );
+	}
+}
+
+void ExpressionArena::set( RecursiveExpression & list, std::string_view value, LiteralArray && elements )
+{
+	const LiteralArray * shared = NULL;
+	size_t hash = elements.hash();
+	typedef std::unordered_multimap< size_t, const LiteralArray * >::const_iterator iter;
+	for( std::pair< iter, iter > range = m_shareableLiterals.equal_range( hash ); range.first != range.second;
+		++range.first )
+	{
+		if( *range.first->second == elements )
+		{
+			shared = range.first->second;
+			++m_numShared;
+			break;
+		}
+	}
+	if( !shared )
+	{
+		m_packed.push_back( std::move( elements ) );
+		m_packed.back().shrink_to_fit();
+		shared = &m_packed.back();
+		m_shareableLiterals.insert( std::make_pair( hash, shared ) );
+	}
+
+	link( list, m_names->str( m_names->intern( value ) ), EList, NULL, 0 );
+	list.m_elements = shared;
+	list.m_packed = true;
+}
+
+void ExpressionArena::addShared( size_t hash, const RecursiveExpression * params, size_t numParams )
+{
+	m_shareable.insert( std::make_pair( hash, std::make_pair( params, numParams ) ) );
+}
+
+void ExpressionArena::reuse( size_t size )
+{
+	++m_numShared;
+	m_sharedSize += size;
+}
+
+void ExpressionArena::clearShared()
+{
+	std::unordered_multimap< size_t, std::pair< const RecursiveExpression *, size_t > >().swap( m_shareable );
+	std::unordered_multimap< size_t, const LiteralArray * >().swap( m_shareableLiterals );
+}
+
+RecursiveExpression * ExpressionArena::expand( LiteralArray const& elements )
+{
+	RecursiveExpression * exprs = allocate( elements.size() );
+	for( size_t i = 0; i < elements.size(); ++i )
+	{
+		if( elements.type() == EString )
+		{
+			set( exprs[i], elements.text( i ), EString, NULL, 0 );
+		}
+		else
+		{
+			set( exprs[i], std::string( elements.text( i ) ), elements.type(), elements.value( i ) );
+		}
+	}
+	return exprs;
+}
+
+void ExpressionArena::fold( RecursiveExpression & concat, std::string && value )
+{
+	RecursiveExpression * original = allocate( 1 );
+	*original = concat;
+
+	m_literals.push_back( std::move( value ) );
+	link( concat, m_literals.back(), EString, NULL, 0 );
+	concat.m_original = original;
+	concat.m_folded = true;
+}
+
+LiteralArray::LiteralArray( ExpressionType type )
+	: m_type( type )
+{
+}
+
+bool LiteralArray::add( std::string_view text, LiteralValue value )
+{
+	if( text.size() > std::numeric_limits< uint32_t >::max() - m_text.size() )
+	{
+		return false;
+	}
+	if( m_type != EString )
+	{
+		m_values.push_back( value );
+	}
+	m_text.append( text );
+	m_ends.push_back( static_cast< uint32_t >( m_text.size() ) );
+	return true;
+}
+
+bool LiteralArray::add( std::string_view text )
+{
+	LiteralValue value = LiteralValue();
+	if( m_type != EString && !decodeLiteral( text, m_type, value ) )
+	{
+		return false;
+	}
+	return add( text, value );
+}
+
+void LiteralArray::shrink_to_fit()
+{
+	m_values.shrink_to_fit();
+	m_text.shrink_to_fit();
+	m_ends.shrink_to_fit();
+}
+
+// the values are decoded from the text so they are the same if it is
+bool LiteralArray::operator==( LiteralArray const& other ) const
+{
+	return m_type == other.m_type && m_ends == other.m_ends && m_text == other.m_text;
+}
+
+size_t LiteralArray::hash() const
+{
+	size_t res = combineHash( std::hash< std::string >()( m_text ), m_ends.size() );
+	return combineHash( res, m_type );
+}
+
+void ExpressionArena::link( RecursiveExpression & expr, std::string const& value, ExpressionType type,
+		const RecursiveExpression * params, size_t numParams )
+{
+	expr.m_value = &value;
+	expr.m_type = static_cast< uint8_t >( type );
+	expr.m_link = RecursiveExpression::ENotLinked;
+	expr.m_packed = false;
+	expr.m_folded = false;
+	expr.m_params = params;
+	expr.m_numParams = static_cast< uint32_t >( numParams );
+	expr.m_arena = this;
+
+	if( hasLiteralValue( type ) && !decodeLiteral( value, type, expr.m_literal ) )
+	{
+		std::ostringstream oss;
+		oss << value << " is not a valid " << ( type == EInt ? "int" : type == EReal ? "real" : "boolean" );
+		throw std::invalid_argument( oss.str() );
+	}
+}
+
+void ExpressionArena::link( RecursiveExpression & expr, std::string const& value, ExpressionType type,
+		LiteralValue literal )
+{
+	expr.m_value = &value;
+	expr.m_type = static_cast< uint8_t >( type );
+	expr.m_link = RecursiveExpression::ENotLinked;
+	expr.m_packed = false;
+	expr.m_folded = false;
+	expr.m_literal = literal;
+	expr.m_numParams = 0;
+	expr.m_arena = this;
+}
 
 // check if it is the end of token. If it's a whitespace, skip past it but it is
 // the end of token
 
-bool isEndOfToken( std::string::const_iterator & iter, std::string::const_iterator end )
+bool isEndOfToken( iter_type & iter, iter_type end )
 {
 	if( iter==end )
 	{
@@ -286,7 +588,7 @@ TokenData readAlpha( iter_type & iter, iter_type end )
 	}
 }
 
-TokenData readNumeric( iter_type & iter, iter_type end )
+TokenData readNumeric( iter_type & iter, iter_type end, LiteralValue & literal )
 {
 	TokenData res( tkdInit );
 		// it's a number or an error
@@ -300,32 +602,11 @@ TokenData readNumeric( iter_type & iter, iter_type end )
 			hasPoint = true;
 		}
 	}
-	std::string extra;
-	std::istringstream iss( res.first );
-	if( hasPoint ) // it's a double
-	{
-		// yes, we could templatize these few lines
-		double v;
-		if( iss >> v ) 
-		{
-			iss >> extra;
-			if( extra.empty() )
-			{
-				res.second = EReal;
-			}
-		}
-	}
-	else
+	// the value is decoded here once, rather than every time it is bound
+	ExpressionType type = hasPoint ? EReal : EInt;
+	if( decodeLiteral( res.first, type, literal ) )
 	{
-		long v;
-		if( iss >> v ) 
-		{
-			iss >> extra;
-			if( extra.empty() )
-			{
-				res.second = EInt;
-			}
-		}
+		res.second = type;
 	}
 	
 	// if we got here and didn't set to EReal or EInt
@@ -352,8 +633,8 @@ TokenData readNumeric( iter_type & iter, iter_type end )
 }
 
 // this is the main parsing function
-TokenData readToken( std::string::const_iterator & iter,
-															  std::string::const_iterator end )
+// the value of a literal int, real or boolean is decoded into literal
+TokenData readToken( iter_type & iter, iter_type end, LiteralValue & literal )
 {
 	// create the result variable here
 	std::pair< std::string, ExpressionType > res( "", EError );
@@ -412,13 +693,17 @@ TokenData readToken( std::string::const_iterator & iter,
 	
 	if( ::isalpha( *iter ) )
 	{
-		return readAlpha( iter, end );
-
+		res = readAlpha( iter, end );
+		if( res.second == EBool )
+		{
+			decodeLiteral( res.first, EBool, literal );
+		}
+		return res;
 	}
 	else
 	{
 		// it might be numeric, or it's an error
-		return readNumeric( iter, end );
+		return readNumeric( iter, end, literal );
 	}
 	
 
@@ -432,74 +717,183 @@ TokenData readToken( std::string::const_iterator & iter,
 
 
 // this is done in a class so it can be easily split into functions without having to
-// either pass around too many parameters or worry about access to RecursiveExpression
-// as this class is a friend.
+// pass around too many parameters.
 
 // One instance of this class parses one "line" expression which may of course have embedded
 // expressions.
 
-// In essence it is passed an "empty" expression expr and a line of text and fills in the
-// expression. If the expression has an error, it does not throw but sets the expression
-// type to EError and the value to the error message.
+// The expression is first built as a list of nodes that refer to their parent by index, in
+// the order they were read. If the expression has an error, it does not throw but sets the
+// head node type to EError and the value to the error message. Once complete the nodes are
+// laid out in the arena so the parameters of each expression are contiguous.
+
+struct ParseNode
+{
+	std::string m_value;
+	ExpressionType m_type;
+	size_t m_parent;
+	size_t m_numParams;
+	LiteralValue m_literal; // only for literal ints, reals and booleans
+	size_t m_packed; // for a List, its packed elements in the parser, if any
+};
+
+const size_t noNode = static_cast< size_t >( -1 );
 
 class RecursiveExpressionParser
 {
+	// reused between parses on the same thread
+	std::vector< ParseNode > & m_nodes;
+
+	// the literal elements of Lists, which are not nodes unless they have to be unpacked
+	std::vector< LiteralArray > m_packs;
 
-	RecursiveExpression * m_expr;
-	RecursiveExpression * m_curr;
-	RecursiveExpression * m_parent;
+	size_t m_expr;
+	size_t m_curr;
+	size_t m_parent;
 
-	std::string const& m_line;
+	std::string_view m_line;
 	std::string const& m_currentDir;
 	iter_type m_iter;
 	iter_type m_end;
 
+	// the line is only copied into a string when we need it for an error message
+	std::string lineText() const
+	{
+		return std::string( m_line );
+	}
+
+	ParseNode & node( size_t idx )
+	{
+		return m_nodes[idx];
+	}
+
+	// value is taken by value as it may refer to another node
+	size_t create( size_t parent, std::string value, ExpressionType type, LiteralValue literal = LiteralValue() )
+	{
+		ParseNode created = { std::move( value ), type, parent, 0, literal, noNode };
+		m_nodes.push_back( std::move( created ) );
+		if( parent != noNode )
+		{
+			++node( parent ).m_numParams;
+		}
+		return m_nodes.size() - 1;
+	}
+
+	// The elements of a List are packed as they are read for as long as they are all literals
+	// of the same type. If anything else turns up, what was packed is unpacked into nodes, which
+	// keeps them in order as nothing else has been added to the List. A literal is only packed
+	// if what follows means it cannot itself become a parent.
+	bool pack( TokenData const& token, LiteralValue literal )
+	{
+		ParseNode & list = node( m_parent );
+		if( list.m_type != EList )
+		{
+			return false;
+		}
+
+		bool packable = ( token.second == EInt || token.second == EReal || token.second == EString ) &&
+			m_iter != m_end && ( *m_iter == ',' || *m_iter == ']' || *m_iter == ')' );
+		if( list.m_packed == noNode )
+		{
+			if( !packable || list.m_numParams != 0 )
+			{
+				return false;
+			}
+			list.m_packed = m_packs.size();
+			m_packs.push_back( LiteralArray( token.second ) );
+		}
+
+		if( !packable || m_packs[ list.m_packed ].type() != token.second ||
+			!m_packs[ list.m_packed ].add( token.first, literal ) )
+		{
+			unpack( m_parent );
+			return false;
+		}
+		++list.m_numParams;
+		return true;
+	}
+
+	void unpack( size_t idx )
+	{
+		LiteralArray packed( EString );
+		std::swap( packed, m_packs[ node( idx ).m_packed ] );
+		node( idx ).m_packed = noNode;
+		node( idx ).m_numParams = 0; // create() counts them again
+
+		for( size_t i = 0; i < packed.size(); ++i )
+		{
+			create( idx, std::string( packed.text( i ) ), packed.type(),
+				packed.type() == EString ? LiteralValue() : packed.value( i ) );
+		}
+	}
+
+	// a short List is left as nodes
+	void endList( size_t idx )
+	{
+		if( node( idx ).m_packed != noNode && m_packs[ node( idx ).m_packed ].size() < LiteralArray::minSize )
+		{
+			unpack( idx );
+		}
+	}
+
+	void setError( std::string const& value )
+	{
+		node( m_expr ).m_type = EError;
+		node( m_expr ).m_value = value;
+		node( m_expr ).m_packed = noNode;
+	}
+
 public:
 
-	explicit RecursiveExpressionParser( RecursiveExpression * expr, std::string const& line, std::string const& currentDir )
-		: m_expr( expr ), m_curr( expr ), m_parent( NULL ), m_line( line ), m_currentDir( currentDir ),
-		m_iter( line.begin() ),	m_end( line.end() )
+	RecursiveExpressionParser( std::vector< ParseNode > & nodes, std::string_view line, std::string const& currentDir )
+		: m_nodes( nodes ), m_expr( noNode ), m_curr( noNode ), m_parent( noNode ), m_line( line ),
+		m_currentDir( currentDir ), m_iter( line.begin() ), m_end( line.end() )
 	{
+		m_nodes.clear();
+		m_expr = m_curr = create( noNode, "Expression is empty", EError );
+
 		while( m_iter != m_end )
 		{
 			// first read a token
-			std::pair< std::string, ExpressionType > res = readToken( m_iter, m_end );
+			LiteralValue literal = LiteralValue();
+			std::pair< std::string, ExpressionType > res = readToken( m_iter, m_end, literal );
 			// If we have an error, propagate it to the head expression
 
 			if( res.second == EError )
 			{
 				std::ostringstream oss;
 				oss << res.first << "\n" << "  while parsing expression:\n\t" << m_line;
-				m_expr->setError( oss.str() );
+				setError( oss.str() );
 				return;
 			}
 
 			// if it's not a void. 
 			if( res.second != EVoid )
 			{
-				if( m_parent )
+				if( m_parent != noNode )
 				{
-					m_curr = RecursiveExpression::create( m_parent, res.first, res.second );
+					m_curr = pack( res, literal ) ? noNode : create( m_parent, res.first, res.second, literal );
 				}
 				else
 				{
-					m_expr->m_value = res.first;
-					m_expr->m_type = res.second;
+					node( m_expr ).m_value = res.first;
+					node( m_expr ).m_type = res.second;
+					node( m_expr ).m_literal = literal;
 				}
 			}
 			else
 			{
-				if( !m_parent )
+				if( m_parent == noNode )
 				{
-					m_expr->setError( "Unexpected empty expression found" );
+					setError( "Unexpected empty expression found" );
 					return;
 				}
 				else
 				{
-					if( !m_parent->m_params.empty() )
+					if( node( m_parent ).m_numParams != 0 )
 					{
 						// also an error
-						m_expr->setError( "Unexpected empty expression found in " + m_parent->m_value + " in m_line " + m_line );
+						setError( "Unexpected empty expression found in " + node( m_parent ).m_value + " in m_line " + lineText() );
 						return;
 					}
 
@@ -514,14 +908,14 @@ public:
 				if( m_curr != m_expr )
 				{
 					std::ostringstream oss;
-					oss << "Missing ) for " << m_parent->value() << " in expression " << m_line;
-					m_expr->setError( oss.str() );
+					oss << "Missing ) for " << node( m_parent ).m_value << " in expression " << m_line;
+					setError( oss.str() );
 					return;
 				}
 				else
 				{
-					m_expr->m_value = res.first;
-					m_expr->m_type = res.second;
+					node( m_expr ).m_value = res.first;
+					node( m_expr ).m_type = res.second;
 				}
 				// else we are at the m_end
 			}
@@ -533,7 +927,7 @@ public:
 					{
 						// we need to "push". what is currently m_curr becomes m_parent
 						m_parent = m_curr;
-						m_curr = NULL; 
+						m_curr = noNode; 
 						++m_iter;
 					}
 					break;
@@ -541,6 +935,10 @@ public:
 					default: // either a comma, colon or a close bracket/brace/parenthesis
 					{
 						expressionEnd();
+						if( node( m_expr ).m_type == EError )
+						{
+							return;
+						}
 					}
 				}
 			}
@@ -556,50 +954,50 @@ public:
 		do
 		{
 			terminator = *m_iter;
-			if( !m_parent )
+			if( m_parent == noNode )
 			{
 				std::ostringstream oss;
 				oss << "Unexpected " << terminator << " in expression " << m_line;
-				m_expr->setError( oss.str() );
+				setError( oss.str() );
 				return;
 			}
 			switch( terminator )
 			{
 				case ',': // token end, move to next sibling
 				{
-					m_curr = NULL; // will be a new sibling read in next
+					m_curr = noNode; // will be a new sibling read in next
 					++m_iter;
 
-					if( m_parent->type() == EMap )
+					if( node( m_parent ).m_type == EMap )
 					{
-						m_expr->setError( "A map element requires a key and " 
-							+ m_line );
+						setError( "A map element requires a key and " 
+							+ lineText() );
 
 						return;
 					}
 					
 					// parent type is EPair when we have read in key of the pair and are now reading the value
-					if( m_parent->type() == EPair )
+					if( node( m_parent ).m_type == EPair )
 					{
-						m_parent = m_parent->m_parent; // move back to the map
+						m_parent = node( m_parent ).m_parent; // move back to the map
 					}
 					return; // we don't loop this case
 				}
 				case ':': // must be key element of a pair
 				{
-					if( m_parent->type() != EMap )
+					if( node( m_parent ).m_type != EMap || m_curr == noNode )
 					{
-						m_expr->setError( "Invalid token ':', only used for maps, in " + m_line );
+						setError( "Invalid token ':', only used for maps, in " + lineText() );
 						return;
 					}
 					else
 					{
 						// The current expression we were parsing is now a Pair and whatever we read
 						// because the first sub-expression
-					    RecursiveExpression::create( m_curr, m_curr->value(), m_curr->type() );
-						m_curr->m_type = EPair; // RecursiveExpressionParser is a friend and can change this..
+						create( m_curr, node( m_curr ).m_value, node( m_curr ).m_type, node( m_curr ).m_literal );
+						node( m_curr ).m_type = EPair;
 						m_parent = m_curr;
-						m_curr = NULL;
+						m_curr = noNode;
 						++m_iter; // move on to value expression for pair
 					}
 					return; // do not loop
@@ -607,42 +1005,43 @@ public:
 				case ')': // usual expression terminator
 				{
 					m_curr = m_parent; 
-					m_parent = m_parent->m_parent;
+					m_parent = node( m_parent ).m_parent;
 					
 					// check number of parameters here
-					switch( m_curr->type() )
+					switch( node( m_curr ).m_type )
 					{
 					case ELibrary:
-						if( m_curr->m_params.size() != 1 )
+						if( node( m_curr ).m_numParams != 1 && node( m_curr ).m_numParams != 2 )
 						{
-							m_expr->setError( "A Library must have exactly one parameter (path) in " + m_line );
+							setError( "A Library must have a path and optionally a list of the libraries it needs opened first in "
+								+ lineText() );
 							return;
 						}
 						if( m_curr != m_expr )
 						{
-							m_expr->setError( "Libraries must be declared as a main expression and cannot be embedded : in " 
-								+ m_line );
+							setError( "Libraries must be declared as a main expression and cannot be embedded : in " 
+								+ lineText() );
 							return;
 						}
 						break;
 
 					case EClass:
-						if( m_curr->m_params.size() != 2 )
+						if( node( m_curr ).m_numParams != 2 )
 						{
-							m_expr->setError( "A Class must have exactly two parameters (libraryName, symbol) in " + m_line );
+							setError( "A Class must have exactly two parameters (libraryName, symbol) in " + lineText() );
 							return;
 						}
 						if( m_curr != m_expr )
 						{
-							m_expr->setError( "Classes must be declared as a main expression and cannot be embedded : in " 
-								+ m_line );
+							setError( "Classes must be declared as a main expression and cannot be embedded : in " 
+								+ lineText() );
 							return;
 						}
 						break;
 
 					case EPair: case EMap: // wrong syntax for these types
 						{
-							m_expr->setError( "Invalid token ')' in line " + m_line );
+							setError( "Invalid token ')' in line " + lineText() );
 							return;
 						}
 						// There are some other restrictions of pairs. The first parameter must be a literal,
@@ -653,22 +1052,25 @@ public:
 						{
 							// A list has 2 syntaxes. If you used List( then you terminate this way.
 							// If you used [ then you must terminate with ] not )
-							if( m_parent->value() == "[" )
-								m_expr->setError( "Invalid syntax ')' in list " + m_line );
-							return;
+							if( node( m_curr ).m_value == "[" )
+							{
+								setError( "Invalid syntax ')' in list " + lineText() );
+								return;
+							}
+							endList( m_curr );
 						}
 						break;
 
 					case ECurrentDir:
-						if( m_curr->m_params.size() != 0 )
+						if( node( m_curr ).m_numParams != 0 )
 						{
-							m_expr->setError( "CurrentDir cannot take parameters" );
+							setError( "CurrentDir cannot take parameters" );
 							return;
 						}
 						else
 						{
-							m_curr->m_type = EString;
-							m_curr->m_value = m_currentDir;
+							node( m_curr ).m_type = EString;
+							node( m_curr ).m_value = m_currentDir;
 						}
 						break;
 
@@ -685,35 +1087,36 @@ public:
 
 				case ']': // terminator for list
 				{
-					if( (m_parent->type() != EList) || (m_parent->value() != "[") )
+					if( (node( m_parent ).m_type != EList) || (node( m_parent ).m_value != "[") )
 					{
-						m_expr->setError( "Syntax error ']' in " + m_line );
+						setError( "Syntax error ']' in " + lineText() );
 						return;
 					}
 					else
 					{
 						m_curr = m_parent; 
-						m_parent = m_parent->m_parent;
+						m_parent = node( m_parent ).m_parent;
+						endList( m_curr );
 					}
 				}
 				break;
 
 				case '}': // terminator for map
 				{
-					if( m_parent->type() == EPair ) 
+					if( node( m_parent ).m_type == EPair ) 
 					{
-						m_curr = m_parent->m_parent;
-						m_parent = m_curr->m_parent;
+						m_curr = node( m_parent ).m_parent;
+						m_parent = node( m_curr ).m_parent;
 					}
-					else if( (m_parent->type() == EMap) && !m_curr )
+					else if( (node( m_parent ).m_type == EMap) && m_curr == noNode )
 					{
 						// empty map
 						m_curr = m_parent; 
-						m_parent = m_parent->m_parent;
+						m_parent = node( m_parent ).m_parent;
 					}
 					else
 					{
-						m_expr->setError( "Syntax error '}' in " + m_line );
+						setError( "Syntax error '}' in " + lineText() );
 						return;
 					}
 				}
@@ -723,9 +1126,9 @@ public:
 				{
 					std::ostringstream oss;
 					oss << "Unexpected character " << terminator << " expected , or ) in " <<
-						m_parent->m_value << " in expression " << m_line;
+						node( m_parent ).m_value << " in expression " << m_line;
 
-					m_expr->setError( oss.str() );
+					setError( oss.str() );
 				}
 			}
 
@@ -737,15 +1140,15 @@ public:
 			if (! skipWhitespace( m_iter, m_end ) )
 			{
 				// this is what we will encounter most of the time...
-				if( m_parent ) // error, it should be null
+				if( m_parent != noNode ) // error, it should be null
 				{
 					std::string open = "(";
-					if( m_parent->m_value == "[" || m_parent->m_value == "{" )
+					if( node( m_parent ).m_value == "[" || node( m_parent ).m_value == "{" )
 					{
-						open = m_parent->m_value;
+						open = node( m_parent ).m_value;
 					}
-					m_expr->setError ( "Unmatched " + open + " for " + 
-						m_parent->m_value + " in " + m_line );
+					setError( "Unmatched " + open + " for " + 
+						node( m_parent ).m_value + " in " + lineText() );
 				}
 				// we have everything, we can just exit.
 				return;
@@ -755,22 +1158,213 @@ public:
 			// parameters, thus not ) or , Do not be fooled by the fact that , ends a pair that
 			// takes 2 parameters
 	}
+
+	// literal values have already been decoded so are passed on as they are
+	void setNode( ExpressionArena & arena, RecursiveExpression & expr, ParseNode & from,
+		const RecursiveExpression * params )
+	{
+		if( from.m_packed != noNode )
+		{
+			arena.set( expr, from.m_value, std::move( m_packs[ from.m_packed ] ) );
+		}
+		else if( hasLiteralValue( from.m_type ) )
+		{
+			arena.set( expr, std::move( from.m_value ), from.m_type, from.m_literal );
+		}
+		else
+		{
+			arena.set( expr, std::move( from.m_value ), from.m_type, params, from.m_numParams );
+		}
+	}
+
+	// whether the nodes children[first] onwards are the same as the numParams expressions
+	// at params, all the way down
+	bool sameParams( std::vector< size_t > const& children, std::vector< size_t > const& firstChild,
+		size_t first, size_t numParams, const RecursiveExpression * params )
+	{
+		std::vector< std::pair< size_t, const RecursiveExpression * > > pending;
+		for( size_t i = 0; i < numParams; ++i )
+		{
+			pending.push_back( std::make_pair( children[ first + i ], params + i ) );
+		}
+		while( !pending.empty() )
+		{
+			ParseNode const& from = node( pending.back().first );
+			const RecursiveExpression * expr = pending.back().second;
+			size_t childrenAt = firstChild[ pending.back().first ];
+			pending.pop_back();
+
+			if( from.m_type != expr->type() || from.m_value != expr->value() )
+			{
+				return false;
+			}
+			const LiteralArray * elements = expr->literals();
+			if( from.m_packed != noNode || elements )
+			{
+				if( from.m_packed == noNode || !elements || !( m_packs[ from.m_packed ] == *elements ) )
+				{
+					return false;
+				}
+				continue;
+			}
+			if( from.m_numParams != expr->params().size() )
+			{
+				return false;
+			}
+			for( size_t i = 0; i < from.m_numParams; ++i )
+			{
+				pending.push_back( std::make_pair( children[ childrenAt + i ], &expr->paramAt( i ) ) );
+			}
+		}
+		return true;
+	}
+
+	// Lays the nodes out in the arena depth first, so each expression's parameters are
+	// allocated together. Children are in the order they were read, which is the order
+	// they appear in m_nodes. Parameters already laid out identically by an earlier parse
+	// into the arena are shared rather than laid out again, unless there is an object among
+	// them, as every anonymous object expression must still make an object of its own.
+	RecursiveExpression * layout( ExpressionArena & arena )
+	{
+		// parameters smaller than this are not worth looking up
+		const size_t minShared = 8;
+
+		size_t count = m_nodes.size();
+		if( node( m_expr ).m_type == EError )
+		{
+			count = 1; // the error is all that is wanted
+		}
+
+		RecursiveExpression * root = arena.allocate( 1 );
+		if( count == 1 )
+		{
+			node( m_expr ).m_numParams = 0;
+			setNode( arena, *root, node( m_expr ), NULL );
+			return root;
+		}
+
+		// group the children of each node together, using each node's parameter count
+		std::vector< size_t > firstChild( count + 1, 0 );
+		for( size_t i = 1; i < count; ++i )
+		{
+			firstChild[ node( i ).m_parent + 1 ] += 1;
+		}
+		for( size_t i = 1; i <= count; ++i )
+		{
+			firstChild[i] += firstChild[i-1];
+		}
+		std::vector< size_t > children( count );
+		std::vector< size_t > next( firstChild.begin(), firstChild.end() - 1 );
+		for( size_t i = 1; i < count; ++i )
+		{
+			children[ next[ node( i ).m_parent ]++ ] = i;
+		}
+
+		// The structural hash and size of every sub-tree, and of the parameters of each
+		// node, which come after it so are done first
+		std::vector< size_t > hashes( count );
+		std::vector< size_t > paramsHashes( count );
+		std::vector< size_t > sizes( count );
+		std::vector< char > hasObject( count );
+		std::vector< char > shareable( count );
+		for( size_t idx = count; idx-- > 0; )
+		{
+			ParseNode const& curr = node( idx );
+			size_t paramsHash = 0;
+			size_t size = 1;
+			bool object = false;
+			if( curr.m_packed != noNode )
+			{
+				paramsHash = m_packs[ curr.m_packed ].hash();
+			}
+			else
+			{
+				for( size_t i = 0; i < curr.m_numParams; ++i )
+				{
+					size_t child = children[ firstChild[idx] + i ];
+					paramsHash = combineHash( paramsHash, hashes[ child ] );
+					size += sizes[ child ];
+					object = object || hasObject[ child ];
+				}
+			}
+			paramsHashes[idx] = paramsHash;
+			hashes[idx] = combineHash( combineHash( std::hash< std::string >()( curr.m_value ), curr.m_type ),
+				paramsHash );
+			sizes[idx] = size;
+			hasObject[idx] = object || curr.m_type == EObject;
+			shareable[idx] = !object && size - 1 >= minShared;
+		}
+
+		// each node is set once its parameters are, so those of a node can be looked up
+		// by a later parse as soon as they are done
+		struct Pending
+		{
+			size_t m_node;
+			RecursiveExpression * m_expr;
+			RecursiveExpression * m_params;
+			size_t m_next;
+			bool m_shareable;
+		};
+		std::vector< Pending > pending;
+		Pending top = { m_expr, root, NULL, 0, false };
+		pending.push_back( top );
+		while( !pending.empty() )
+		{
+			Pending & curr = pending.back();
+			ParseNode & from = node( curr.m_node );
+			size_t first = firstChild[ curr.m_node ];
+			size_t numChildren = from.m_packed == noNode ? from.m_numParams : 0;
+			if( numChildren && !curr.m_params )
+			{
+				curr.m_shareable = shareable[ curr.m_node ] != 0;
+				const RecursiveExpression * shared = curr.m_shareable ?
+					arena.findShared( paramsHashes[ curr.m_node ], numChildren,
+						[ & ]( const RecursiveExpression * params )
+						{
+							return sameParams( children, firstChild, first, numChildren, params );
+						} ) : NULL;
+				if( shared )
+				{
+					arena.reuse( sizes[ curr.m_node ] - 1 );
+					setNode( arena, *curr.m_expr, from, shared );
+					pending.pop_back();
+					continue;
+				}
+				curr.m_params = arena.allocate( numChildren );
+			}
+
+			if( curr.m_next < numChildren )
+			{
+				Pending child = { children[ first + curr.m_next ], curr.m_params + curr.m_next, NULL, 0, false };
+				++curr.m_next;
+				pending.push_back( child ); // curr is no longer valid
+				continue;
+			}
+
+			if( curr.m_shareable )
+			{
+				arena.addShared( paramsHashes[ curr.m_node ], curr.m_params, numChildren );
+			}
+			setNode( arena, *curr.m_expr, from, curr.m_params );
+			pending.pop_back();
+		}
+		return root;
+	}
 };
-	
-RecursiveExpressionPtr RecursiveExpression::parse( std::string const& line, std::string const& currentDir )
-{
 
-	RecursiveExpressionPtr exprShared( RecursiveExpression::create() );
+RecursiveExpressionPtr RecursiveExpression::parse( std::string_view line, std::string const& currentDir,
+	ExpressionArena & arena )
+{
+	static thread_local std::vector< ParseNode > nodes;
 
-	RecursiveExpressionParser parser( exprShared.get(), line, currentDir );
-	return exprShared;
+	RecursiveExpressionParser parser( nodes, line, currentDir );
+	return arena.share( parser.layout( arena ) );
 }
-	
-	// the "head" expression is expr
-	// curr can move to child ones
-	 // if parent is NULL we are building the main expression
-
 
-	// I don't think we should ever get here.. but just in case
+RecursiveExpressionPtr RecursiveExpression::parse( std::string_view line, std::string const& currentDir )
+{
+	spns::shared_ptr< ExpressionArena > arena( new ExpressionArena );
+	return parse( line, currentDir, *arena );
+}
 
 }
@@ -0,0 +1,118 @@
+#include "stdafx.h"
+
+#include "SymbolTable.h"
+#include <functional>
+#include <stdexcept>
+
+namespace IOC { namespace detail {
+
+uint32_t SymbolTable::hash( std::string_view str )
+{
+	uint64_t res = std::hash< std::string_view >()( str );
+	return static_cast< uint32_t >( res ^ ( res >> 32 ) );
+}
+
+size_t SymbolTable::slotOf( std::string_view str, uint32_t hash ) const
+{
+	const size_t mask = m_slots.size() - 1;
+	size_t slot = hash & mask;
+	while( m_slots[slot].m_id != npos &&
+		( m_slots[slot].m_hash != hash || m_strings[ m_slots[slot].m_id ] != str ) )
+	{
+		slot = ( slot + 1 ) & mask;
+	}
+	return slot;
+}
+
+SymbolTable::symbol_id SymbolTable::intern( std::string_view str )
+{
+	if( m_slots.empty() )
+	{
+		rehash( 16 );
+	}
+	uint32_t strHash = hash( str );
+	size_t slot = slotOf( str, strHash );
+	if( m_slots[slot].m_id == npos )
+	{
+		return add( std::string( str ), slot, strHash );
+	}
+	return m_slots[slot].m_id;
+}
+
+SymbolTable::symbol_id SymbolTable::intern( std::string && str )
+{
+	if( m_slots.empty() )
+	{
+		rehash( 16 );
+	}
+	uint32_t strHash = hash( str );
+	size_t slot = slotOf( str, strHash );
+	if( m_slots[slot].m_id == npos )
+	{
+		return add( std::move( str ), slot, strHash );
+	}
+	return m_slots[slot].m_id;
+}
+
+SymbolTable::symbol_id SymbolTable::add( std::string && str, size_t slot, uint32_t hash )
+{
+	if( m_strings.size() >= npos )
+	{
+		throw std::length_error( "Too many symbols" );
+	}
+	symbol_id id = static_cast< symbol_id >( m_strings.size() );
+	m_strings.push_back( std::move( str ) );
+	m_slots[slot].m_hash = hash;
+	m_slots[slot].m_id = id;
+
+	if( m_strings.size() > m_slots.size() / 4 * 3 )
+	{
+		rehash( m_slots.size() * 2 );
+	}
+	return id;
+}
+
+SymbolTable::symbol_id SymbolTable::find( std::string_view str ) const
+{
+	if( m_slots.empty() )
+	{
+		return npos;
+	}
+	return m_slots[ slotOf( str, hash( str ) ) ].m_id;
+}
+
+void SymbolTable::reserve( size_t count )
+{
+	size_t capacity = m_slots.empty() ? 16 : m_slots.size();
+	while( count > capacity / 4 * 3 )
+	{
+		capacity *= 2;
+	}
+	if( capacity != m_slots.size() )
+	{
+		rehash( capacity );
+	}
+}
+
+// the hashes are kept so the strings do not have to be hashed again
+void SymbolTable::rehash( size_t capacity )
+{
+	const Slot empty = { 0, npos };
+	std::vector< Slot > slots( capacity, empty );
+	const size_t mask = capacity - 1;
+	for( Slot const& from : m_slots )
+	{
+		if( from.m_id != npos )
+		{
+			size_t slot = from.m_hash & mask;
+			while( slots[slot].m_id != npos )
+			{
+				slot = ( slot + 1 ) & mask;
+			}
+			slots[slot] = from;
+		}
+	}
+	m_slots.swap( slots );
+}
+
+} }
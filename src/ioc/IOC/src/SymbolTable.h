@@ -0,0 +1,70 @@
+#pragma once
+
+#ifndef IOC_SYMBOL_TABLE_H_
+#define IOC_SYMBOL_TABLE_H_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace IOC { namespace detail {
+
+// Each distinct string is stored once and given a number, its symbol, in the order
+// they were added. Strings never move so references to them stay valid for the
+// lifetime of the table.
+//
+// Symbols are found through an open-addressed index, probed linearly, that holds
+// part of each string's hash next to its symbol, so a lookup only compares strings
+// whose hash matches and never has to make a std::string of what it looks up.
+//
+// Not thread-safe.
+
+class SymbolTable
+{
+public:
+	typedef uint32_t symbol_id;
+	static const symbol_id npos = static_cast< symbol_id >( -1 );
+
+	// adds the string if it is not already there
+	symbol_id intern( std::string_view str );
+	symbol_id intern( std::string && str );
+
+	// npos if it is not there
+	symbol_id find( std::string_view str ) const;
+
+	// so count symbols can be added without the index growing
+	void reserve( size_t count );
+
+	std::string const& str( symbol_id id ) const
+	{
+		return m_strings[id];
+	}
+
+	size_t size() const
+	{
+		return m_strings.size();
+	}
+
+private:
+	struct Slot
+	{
+		uint32_t m_hash;
+		symbol_id m_id; // npos if the slot is empty
+	};
+
+	static uint32_t hash( std::string_view str );
+
+	// the slot that holds str, or the empty one where it would go
+	size_t slotOf( std::string_view str, uint32_t hash ) const;
+	symbol_id add( std::string && str, size_t slot, uint32_t hash );
+	void rehash( size_t capacity );
+
+	std::deque< std::string > m_strings;
+	std::vector< Slot > m_slots; // a power of 2 in size, never more than 3/4 full
+};
+
+} }
+
+#endif
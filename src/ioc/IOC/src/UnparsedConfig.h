@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef IOC_UNPARSED_CONFIG_H_
+#define IOC_UNPARSED_CONFIG_H_
+
+#include <IOC/iocfwd.h>
+#include "ConfigCache.h"
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace IOC { namespace detail {
+
+// A config can be loaded without parsing its values, which are then parsed one at a
+// time as they are looked up. Only the statements are read, following #include and
+// #define, and the names checked.
+
+class ConfigLoader;
+
+// the value of a statement as it was read
+struct UnparsedValue
+{
+	std::string_view m_text;
+	std::string const * m_path; // of the file it was read from
+	std::string const * m_currentDir; // for CurrentDir()
+};
+
+// Returns the values in name order, and the files read. They refer to text held by the
+// loader returned, so it must be kept for as long as they are. Throws as loading eagerly
+// does if a name is reserved or redefined, or the files cannot be read.
+spns::shared_ptr< ConfigLoader > loadIOCConfigUnparsed( str_cref filePath,
+		std::map< std::string, UnparsedValue > & values, FileStamps & files );
+
+} }
+
+#endif
@@ -0,0 +1,606 @@
+#include "stdafx.h"
+
+#include <IOC/iocfwd.h>
+#include "SymbolTable.h"
+#include "UnparsedConfig.h"
+#include <boost/regex.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+// ioc-bench times the loader on configs it generates, against the way it used to do the same
+// work, so a change to either can be measured on the same input. It uses the loader's own
+// headers from src/ioc/IOC/src rather than the API, as what it times is not exposed there.
+//
+// scan: configs of 10k, 100k and 1M statements are loaded without parsing their values, once
+// with the statement scanner and once matching each line against the regexes the loader
+// used before it. Either way each name is checked and kept with the text of its value.
+//
+// macros: configs of #define lines whose values refer to 10, 100 and 1000 macros each, 100k
+// references in all, are loaded with the loader's single pass expansion and with the regex
+// that found one reference at a time and rebuilt the string around it.
+//
+// symbols: 1M names are each looked up once, in a shuffled order, by a string_view into one
+// buffer as the loader has them, in the SymbolTable and in the std::map it replaced, which
+// needs a std::string made of each.
+//
+// The configs are written to the directory given, or a temporary one, and left there.
+//
+// Usage: ioc-bench [--dir directory] [scan] [macros] [symbols]
+// With no benchmarks named it runs them all. It exits with 1 if the two ways of loading a
+// config disagree, and 2 if a config cannot be written or loaded.
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// the loader reports each file it loads, which is not wanted while timing it
+class QuietErrors
+{
+public:
+	QuietErrors()
+		: m_buf( std::cerr.rdbuf( NULL ) )
+	{
+	}
+
+	~QuietErrors()
+	{
+		std::cerr.rdbuf( m_buf );
+	}
+
+private:
+	std::streambuf * m_buf;
+};
+
+// the quickest of runs calls, in milliseconds
+template< typename F >
+double bestOf( size_t runs, F const& f )
+{
+	double best = 0;
+	for( size_t run = 0; run < runs; ++run )
+	{
+		Clock::time_point start = Clock::now();
+		f();
+		double ms = std::chrono::duration< double, std::milli >( Clock::now() - start ).count();
+		if( run == 0 || ms < best )
+		{
+			best = ms;
+		}
+	}
+	return best;
+}
+
+// #define only takes letters, so its symbols are numbered in base 26
+std::string macroName( size_t n )
+{
+	std::string res( "M" );
+	do
+	{
+		res += static_cast< char >( 'a' + n % 26 );
+		n /= 26;
+	}
+	while( n );
+	return res;
+}
+
+// Writes a config of count statements much like those we generate: numbers, strings, lists
+// and maps of earlier names, some over several lines, with a comment and a #define every
+// thousand statements.
+void writeConfig( std::string const& path, size_t count )
+{
+	std::ofstream ofs( path.c_str() );
+	ofs << "#! /usr/bin/env IOCApp\n"
+		"#define Root \"/data/sets\"\n";
+
+	for( size_t i = 0; i < count; ++i )
+	{
+		if( i % 1000 == 0 )
+		{
+			ofs << "\n! statements from " << i << '\n'
+				<< "#define " << macroName( i / 1000 ) << " \"$(Root)/set" << i << "\"\n\n";
+		}
+
+		switch( i % 8 )
+		{
+		case 0:
+			ofs << "Count_" << i << " = " << i << ";\n";
+			break;
+		case 1:
+			ofs << "Ratio_" << i << " = 0." << i << ";\n";
+			break;
+		case 2:
+			ofs << "Name_" << i << " = \"name " << i << "\";\n";
+			break;
+		case 3:
+			ofs << "Flag_" << i << " = true;\n";
+			break;
+		case 4:
+			ofs << "List_" << i << " = [ Count_" << i - 4 << ", Name_" << i - 2 << " ];\n";
+			break;
+		case 5:
+			ofs << "Map_" << i << " =\n{\n\t\"count\" : Count_" << i - 5 <<
+				",\n\t\"name\" : Name_" << i - 3 << "\n};\n";
+			break;
+		case 6:
+			ofs << "Path_" << i << " = Concat( CurrentDir(), \"file" << i << ".dat\" );\n";
+			break;
+		default:
+			ofs << "Text_" << i << " = \"a longer string, as descriptions and paths often are, "
+				<< i << "\";\n";
+		}
+	}
+
+	if( !ofs.flush() )
+	{
+		throw std::invalid_argument( "Failed to write config file " + path );
+	}
+}
+
+// Writes a config of count #define lines whose values each refer to perLine macros, made of
+// paths as they usually are, and one statement so it is not empty.
+void writeMacroConfig( std::string const& path, size_t count, size_t perLine )
+{
+	std::ofstream ofs( path.c_str() );
+	const size_t parts = 26;
+	for( size_t n = 0; n < parts; ++n )
+	{
+		ofs << "#define " << macroName( n ) << " \"part" << n << "\"\n";
+	}
+
+	for( size_t i = 0; i < count; ++i )
+	{
+		ofs << "#define " << macroName( parts + i ) << " \"";
+		for( size_t n = 0; n < perLine; ++n )
+		{
+			ofs << "/$(" << macroName( ( i + n ) % parts ) << ')';
+		}
+		ofs << "\"\n";
+	}
+	ofs << "Done = true;\n";
+
+	if( !ofs.flush() )
+	{
+		throw std::invalid_argument( "Failed to write config file " + path );
+	}
+}
+
+std::string trim( std::string const& s )
+{
+	const char* whites = " \t\r";
+
+	size_t startPos = s.find_first_not_of( whites );
+	if( startPos != std::string::npos )
+	{
+		size_t endPos = s.find_last_not_of( whites );
+		return s.substr( startPos, endPos + 1 - startPos );
+	}
+	else
+	{
+		return std::string();
+	}
+}
+
+const char * const includeRegexText = "^#include\\s+\"([^\"]+)\"$";
+const boost::regex includeRegex( includeRegexText );
+
+const std::string wordRegexText = "[A-Za-z][A-Za-z0-9._]*";
+const boost::regex wordRegex( '^' + wordRegexText + '$' );
+
+const std::string equalsRegexText = "^(" + wordRegexText + ")\\s*=\\s*(.+)\\s*;$";
+const boost::regex equalsRegex( equalsRegexText );
+
+const char * const defineRegexText = "^#define\\s+([A-Za-z]+)\\s+\"([^\"]+)\"$";
+const boost::regex defineRegex( defineRegexText );
+
+const char * const envRegexText = "^.*\\$\\(([A-Za-z]+)\\).*$";
+const boost::regex envRegex( envRegexText );
+
+const std::string reservedWordsList[] =
+{
+	"Class", "Concat", "CurrentDir", "Library", "List",
+	"false", "newline", "quote", "tab", "true", "\x7f\x7f"
+};
+
+bool isReserved( std::string const& str )
+{
+	return std::binary_search( &reservedWordsList[0], &reservedWordsList[11], str );
+}
+
+// How ConfigLoader read statements before the scanner: each line is trimmed and matched
+// against the regexes, then the statement against equalsRegex and its name against
+// wordRegex. It keeps the text of each value, as loading unparsed does.
+class RegexLoader
+{
+public:
+	explicit RegexLoader( std::string const& filePath )
+	{
+		m_files.insert( filePath );
+		loadIOCConfig( filePath );
+	}
+
+	std::map< std::string, std::string > const& config() const
+	{
+		return m_config;
+	}
+
+private:
+	void loadIOCConfig( std::string const& filePath );
+	bool processStatement( std::istream & is, std::string const& fileName );
+	std::string expandMacros( std::string const& input, std::string const& fileName ) const;
+
+	static std::string getParentPath( std::string const& fileName )
+	{
+		std::string parentPath = std::filesystem::path( fileName ).parent_path().string();
+		if( parentPath.empty() )
+		{
+			parentPath = std::filesystem::current_path().string();
+		}
+		parentPath.push_back( '/' );
+		return parentPath;
+	}
+
+	std::map< std::string, std::string > m_config;
+	std::set< std::string > m_files;
+	std::map< std::string, std::string > m_defines;
+};
+
+void RegexLoader::loadIOCConfig( std::string const& filePath )
+{
+	std::ifstream ifs( filePath.c_str() );
+	if( !ifs )
+	{
+		throw std::invalid_argument( "Failed to open config file " + filePath );
+	}
+	while( processStatement( ifs, filePath ) );
+}
+
+bool RegexLoader::processStatement( std::istream & is, std::string const& fileName )
+{
+	std::string line;
+	std::string readLine;
+	size_t lineNum = 0;
+	do
+	{
+		if( !std::getline( is, readLine ) )
+		{
+			if( !line.empty() )
+			{
+				throw std::invalid_argument( "End of file found in " + fileName + " Whilst processing " + line );
+			}
+			return false;
+		}
+
+		++lineNum;
+		trim( readLine ).swap( readLine );
+
+		if( readLine.empty() || readLine[0] == '!' )
+		{
+			continue;
+		}
+		else if( readLine[0] == '#' )
+		{
+			if( !line.empty() )
+			{
+				throw std::invalid_argument( "Invalid " + readLine + " after " + line );
+			}
+
+			boost::smatch res;
+			if( readLine.size() > 1 && readLine[1] == '!' )
+			{
+				if( lineNum != 1 )
+				{
+					throw std::invalid_argument( "#! (shebang) only valid on first line of the file" );
+				}
+				continue;
+			}
+			if( boost::regex_match( readLine, res, includeRegex ) )
+			{
+				std::string inc = expandMacros( res[1], fileName );
+				if( inc.find( ':' ) == std::string::npos && inc[0] != '/' )
+				{
+					inc = getParentPath( fileName ) + inc;
+				}
+				if( m_files.insert( inc ).second )
+				{
+					loadIOCConfig( inc );
+				}
+				return true;
+			}
+			else if( boost::regex_match( readLine, res, defineRegex ) )
+			{
+				std::string sym = res[1];
+				std::string value = expandMacros( res[2], fileName );
+				if( sym == "CurrentDir" )
+				{
+					throw std::invalid_argument( "Cannot redefine CurrentDir in " + fileName );
+				}
+				m_defines.insert( std::make_pair( sym, value ) );
+			}
+			else
+			{
+				throw std::invalid_argument( "Invalid syntax " + readLine );
+			}
+		}
+		else
+		{
+			line.append( readLine );
+		}
+	}
+	while( line.empty() || *line.rbegin() != ';' );
+
+	boost::smatch res;
+	if( !boost::regex_match( line, res, equalsRegex ) )
+	{
+		throw std::invalid_argument( "Invalid syntax: " + line );
+	}
+
+	std::string key = res[1];
+	std::string exprText = res[2];
+	if( !boost::regex_match( key, res, wordRegex ) )
+	{
+		throw std::invalid_argument( "Valid characters in names are alpha-numeric . and _ and must begin with alphabetic" );
+	}
+	if( isReserved( key ) )
+	{
+		throw std::invalid_argument( key + " is a reserved word" );
+	}
+	if( !m_config.insert( std::make_pair( key, exprText ) ).second )
+	{
+		throw std::invalid_argument( "Redefinition of " + key );
+	}
+	return true;
+}
+
+std::string RegexLoader::expandMacros( std::string const& input, std::string const& fileName ) const
+{
+	std::string parsed = input;
+	boost::smatch res;
+	while( boost::regex_match( parsed, res, envRegex ) )
+	{
+		std::string sym = res[1];
+		std::string find = "$(" + sym + ")";
+
+		std::string replace;
+		if( sym == "CurrentDir" )
+		{
+			replace = getParentPath( fileName );
+		}
+		else
+		{
+			std::map< std::string, std::string >::const_iterator iter = m_defines.find( sym );
+			if( iter == m_defines.end() )
+			{
+				throw std::invalid_argument( "Undefined macro " + sym + " in " + input + " file " + fileName );
+			}
+			replace = iter->second;
+		}
+		std::string::size_type pos = parsed.find( find );
+		parsed = parsed.substr( 0, pos ) + replace + parsed.substr( pos + sym.size() + 3 );
+	}
+	return parsed;
+}
+
+// returns false if the scanner and the regexes do not agree on how many statements there are
+bool benchScan( std::string const& dir )
+{
+	std::cout << "scan: loading without parsing, best of 3 (1 for 1M statements)\n"
+		<< std::setw( 12 ) << "statements" << std::setw( 12 ) << "regex ms"
+		<< std::setw( 12 ) << "scanner ms" << std::setw( 10 ) << "speedup" << '\n';
+
+	bool agreed = true;
+	const size_t counts[] = { 10000, 100000, 1000000 };
+	for( size_t count : counts )
+	{
+		std::ostringstream oss;
+		oss << dir << "/scan" << count << ".ioc";
+		std::string path = oss.str();
+		writeConfig( path, count );
+
+		size_t runs = count < 1000000 ? 3 : 1;
+		size_t regexCount = 0;
+		size_t scannerCount = 0;
+		double regexMs;
+		double scannerMs;
+		{
+			QuietErrors quiet;
+			regexMs = bestOf( runs, [&]()
+			{
+				RegexLoader loader( path );
+				regexCount = loader.config().size();
+			} );
+
+			scannerMs = bestOf( runs, [&]()
+			{
+				std::map< std::string, IOC::detail::UnparsedValue > values;
+				IOC::detail::FileStamps files;
+				IOC::detail::loadIOCConfigUnparsed( path, values, files );
+				scannerCount = values.size();
+			} );
+		}
+
+		std::cout << std::setw( 12 ) << count << std::fixed << std::setprecision( 1 )
+			<< std::setw( 12 ) << regexMs << std::setw( 12 ) << scannerMs
+			<< std::setw( 9 ) << regexMs / scannerMs << "x\n";
+
+		if( regexCount != count || scannerCount != count )
+		{
+			std::cerr << "ERROR: " << path << " has " << count << " statements but the regexes found "
+				<< regexCount << " and the scanner " << scannerCount << std::endl;
+			agreed = false;
+		}
+	}
+	return agreed;
+}
+
+void benchMacros( std::string const& dir )
+{
+	std::cout << "macros: expanding #define values, best of 3\n"
+		<< std::setw( 12 ) << "per string" << std::setw( 12 ) << "strings" << std::setw( 12 ) << "regex ms"
+		<< std::setw( 12 ) << "single ms" << std::setw( 10 ) << "speedup" << '\n';
+
+	const size_t references = 100000;
+	const size_t perLines[] = { 10, 100, 1000 };
+	for( size_t perLine : perLines )
+	{
+		std::ostringstream oss;
+		oss << dir << "/macros" << perLine << ".ioc";
+		std::string path = oss.str();
+		size_t count = references / perLine;
+		writeMacroConfig( path, count, perLine );
+
+		double regexMs;
+		double singleMs;
+		{
+			QuietErrors quiet;
+			regexMs = bestOf( 3, [&]()
+			{
+				RegexLoader loader( path );
+			} );
+
+			singleMs = bestOf( 3, [&]()
+			{
+				std::map< std::string, IOC::detail::UnparsedValue > values;
+				IOC::detail::FileStamps files;
+				IOC::detail::loadIOCConfigUnparsed( path, values, files );
+			} );
+		}
+
+		std::cout << std::setw( 12 ) << perLine << std::setw( 12 ) << count << std::fixed
+			<< std::setprecision( 1 ) << std::setw( 12 ) << regexMs << std::setw( 12 ) << singleMs
+			<< std::setw( 9 ) << regexMs / singleMs << "x\n";
+	}
+}
+
+// returns false if either fails to find a name
+bool benchSymbols()
+{
+	const size_t count = 1000000;
+	std::string text;
+	std::vector< std::pair< size_t, size_t > > spans;
+	for( size_t i = 0; i < count; ++i )
+	{
+		std::ostringstream oss;
+		oss << ( i % 2 ? "Name_" : "Count_" ) << i;
+		spans.push_back( std::make_pair( text.size(), oss.str().size() ) );
+		text += oss.str();
+	}
+
+	std::vector< std::string_view > names;
+	for( std::pair< size_t, size_t > const& span : spans )
+	{
+		names.push_back( std::string_view( text ).substr( span.first, span.second ) );
+	}
+
+	IOC::detail::SymbolTable symbols;
+	symbols.reserve( count );
+	std::map< std::string, IOC::detail::SymbolTable::symbol_id > map;
+	for( std::string_view name : names )
+	{
+		IOC::detail::SymbolTable::symbol_id id = symbols.intern( name );
+		map.insert( std::make_pair( std::string( name ), id ) );
+	}
+
+	std::shuffle( names.begin(), names.end(), std::mt19937( 42 ) );
+
+	size_t mapFound = 0;
+	size_t tableFound = 0;
+	double mapMs = bestOf( 3, [&]()
+	{
+		mapFound = 0;
+		for( std::string_view name : names )
+		{
+			mapFound += map.find( std::string( name ) ) != map.end();
+		}
+	} );
+
+	double tableMs = bestOf( 3, [&]()
+	{
+		tableFound = 0;
+		for( std::string_view name : names )
+		{
+			tableFound += symbols.find( name ) != IOC::detail::SymbolTable::npos;
+		}
+	} );
+
+	std::cout << "symbols: looking up " << count << " names, best of 3\n"
+		<< std::setw( 12 ) << "" << std::setw( 12 ) << "ms" << std::setw( 12 ) << "M/s" << '\n'
+		<< std::fixed << std::setprecision( 1 )
+		<< std::setw( 12 ) << "std::map" << std::setw( 12 ) << mapMs << std::setw( 12 ) << count / mapMs / 1000 << '\n'
+		<< std::setw( 12 ) << "SymbolTable" << std::setw( 12 ) << tableMs << std::setw( 12 ) << count / tableMs / 1000 << '\n';
+
+	if( mapFound != count || tableFound != count )
+	{
+		std::cerr << "ERROR: of " << count << " names std::map found " << mapFound
+			<< " and SymbolTable " << tableFound << std::endl;
+		return false;
+	}
+	return true;
+}
+
+}
+
+int main( int argc, char* argv[] )
+{
+	std::string dir;
+	int arg = 1;
+	if( arg + 1 < argc && std::string( argv[arg] ) == "--dir" )
+	{
+		dir = argv[arg + 1];
+		arg += 2;
+	}
+
+	std::vector< std::string > benches( argv + arg, argv + argc );
+	if( benches.empty() )
+	{
+		benches.push_back( "scan" );
+		benches.push_back( "macros" );
+		benches.push_back( "symbols" );
+	}
+
+	for( std::string const& bench : benches )
+	{
+		if( bench != "scan" && bench != "macros" && bench != "symbols" )
+		{
+			std::cerr << "Usage " << argv[0] << " [--dir directory] [scan] [macros] [symbols]\n";
+			return 2;
+		}
+	}
+
+	try
+	{
+		if( dir.empty() )
+		{
+			dir = ( std::filesystem::temp_directory_path() / "ioc-bench" ).string();
+		}
+		std::filesystem::create_directories( dir );
+
+		bool agreed = true;
+		for( std::string const& bench : benches )
+		{
+			if( bench == "scan" )
+			{
+				agreed = benchScan( dir ) && agreed;
+			}
+			else if( bench == "macros" )
+			{
+				benchMacros( dir );
+			}
+			else
+			{
+				agreed = benchSymbols() && agreed;
+			}
+		}
+		return agreed ? 0 : 1;
+	}
+	catch( std::exception const& ex )
+	{
+		std::cerr << "ERROR: " << ex.what() << std::endl;
+		return 2;
+	}
+}
@@ -0,0 +1,547 @@
+#include "stdafx.h"
+
+#include <IOC/ioc_api.h>
+#include <IOC/detail/ObjectLoader.h>
+#include <IOC/detail/RecursiveExpression.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+// ioc-compile writes the C++ that constructs an object a config defines, as getRunnable()
+// would, for programs that must start without loading a config. The code is a function that
+// constructs each object directly, in the order they depend on each other, and returns the
+// Runnable. With --main it also writes a main() that runs it. It is compiled against
+// IOC/Compiled.h and linked with the classes rather than opening their libraries.
+//
+// The libraries are not opened here either. Instead a manifest, itself a config, names the
+// builder type each symbol a Class refers to is an instance of, and the headers that declare
+// them:
+//
+//   Headers = [ "myapp/builders.h" ];
+//   g_Counter = "CounterBuilder";
+//   g_Holder = "IOC::Builder2Params< Holder, Base, std::vector< Base >, std::vector< std::string > >";
+//
+// Everything else in the config is resolved now, including CurrentDir(), so the code has to
+// be generated again when the config changes. A value of the wrong type for its parameter
+// fails to compile where getRunnable() would have failed to bind it.
+//
+// Usage: ioc-compile [--main] [--function name] manifestFile configFile name
+// It writes the code to standard output, and exits with 1 if the object cannot be compiled
+// and 2 if the manifest or config cannot be loaded.
+
+namespace {
+
+using IOC::RecursiveExpressionPtr;
+using IOC::expr_cref;
+using IOC::str_cref;
+
+struct CompiledObject
+{
+	std::string m_label; // its name, or its class in brackets if it is anonymous
+	size_t m_builder;
+	std::vector< std::string > m_args;
+};
+
+class ConfigCompiler
+{
+public:
+	ConfigCompiler( str_cref manifestFile, str_cref configFile );
+
+	void compile( str_cref name );
+	void write( std::ostream & os, str_cref function, bool withMain ) const;
+
+private:
+	std::string value( expr_cref expr );
+	std::string list( expr_cref expr );
+	std::string map( expr_cref expr );
+	std::string object( expr_cref expr, str_cref name );
+	size_t builderFor( str_cref className );
+
+	bool literalArray( std::vector< RecursiveExpressionPtr > const& elements, std::string & res );
+	std::string literal( expr_cref expr ) const;
+
+	std::string m_configFile;
+	std::string m_name;
+	IOC::ObjectLoaderPtr m_loader;
+
+	std::vector< std::string > m_headers;
+	std::map< std::string, std::string > m_manifest; // symbol to builder type
+
+	std::map< std::string, size_t > m_builderIds; // by symbol
+	std::vector< std::pair< std::string, std::string > > m_builders; // type and the class it is for
+	std::vector< std::string > m_arrays;
+	std::vector< CompiledObject > m_objects; // in the order they are constructed
+	std::map< std::string, size_t > m_named;
+	std::set< std::string > m_compiling; // to find circular references
+	std::string m_result;
+};
+
+std::string stringLiteral( str_cref str )
+{
+	std::ostringstream oss;
+	oss << '"';
+	for( char ch : str )
+	{
+		if( ch == '"' || ch == '\\' )
+		{
+			oss << '\\' << ch;
+		}
+		else if( ch == '\n' )
+		{
+			oss << "\\n";
+		}
+		else if( ch == '\t' )
+		{
+			oss << "\\t";
+		}
+		else if( static_cast< unsigned char >( ch ) < 0x20 || static_cast< unsigned char >( ch ) >= 0x7f )
+		{
+			// octal, as a hex escape would take any hex digits that follow with it
+			oss << '\\' << std::oct << std::setw( 3 ) << std::setfill( '0' )
+				<< static_cast< unsigned >( static_cast< unsigned char >( ch ) ) << std::dec;
+		}
+		else
+		{
+			oss << ch;
+		}
+	}
+	oss << '"';
+	return oss.str();
+}
+
+// Each List or Map is a tuple of its elements, so a long one is written in parts and joined
+std::string call( str_cref function, std::vector< std::string > const& args )
+{
+	static const size_t maxPart = 64;
+	if( args.size() > maxPart )
+	{
+		std::vector< std::string > parts;
+		for( size_t i = 0; i < args.size(); i += maxPart )
+		{
+			std::vector< std::string > part( args.begin() + i, args.begin() + std::min( i + maxPart, args.size() ) );
+			parts.push_back( call( function, part ) );
+		}
+		return call( "iocc::join", parts );
+	}
+
+	std::string res = function + "(";
+	for( size_t i = 0; i < args.size(); ++i )
+	{
+		res += ( i ? ", " : " " ) + args[i];
+	}
+	return res + ( args.empty() ? ")" : " )" );
+}
+
+ConfigCompiler::ConfigCompiler( str_cref manifestFile, str_cref configFile )
+	: m_configFile( configFile ), m_loader( IOC::getObjectLoader( configFile ) )
+{
+	IOC::ObjectLoaderPtr manifest( IOC::getObjectLoader( manifestFile ) );
+	std::vector< std::string > names;
+	manifest->definitions( names );
+	for( str_cref name : names )
+	{
+		expr_cref expr = manifest->lookup( name );
+		if( name == "Headers" )
+		{
+			std::vector< RecursiveExpressionPtr > headers;
+			manifest->toVector( expr, headers );
+			for( RecursiveExpressionPtr const& header : headers )
+			{
+				std::string str;
+				manifest->convert( *header, str );
+				m_headers.push_back( str );
+			}
+		}
+		else
+		{
+			manifest->convert( expr, m_manifest[ name ] );
+		}
+	}
+}
+
+void ConfigCompiler::compile( str_cref name )
+{
+	m_name = name;
+	RecursiveExpressionPtr expr( IOC::RecursiveExpression::create( name, IOC::EVariable ) );
+	std::string objName;
+	expr_cref target = m_loader->underlying( *expr, &objName ); // throws if it is not defined
+	if( target.type() != IOC::EObject )
+	{
+		std::ostringstream oss;
+		oss << name << " is not an object";
+		throw std::invalid_argument( oss.str() );
+	}
+	m_result = object( target, objName );
+}
+
+// The C++ for a value, constructing any objects it uses first. A named object is constructed
+// once however it is reached, an anonymous one each time its expression is.
+std::string ConfigCompiler::value( expr_cref expr )
+{
+	if( expr.type() == IOC::EVariable )
+	{
+		std::string last;
+		expr_cref target = m_loader->underlying( expr, &last, false );
+		if( target.type() == IOC::EVariable ) // not defined, so the name of an enumerated value
+		{
+			return "iocc::enumerator( " + stringLiteral( last ) + " )";
+		}
+		return target.type() == IOC::EObject ? object( target, last ) : value( target );
+	}
+
+	switch( expr.type() )
+	{
+	case IOC::EList:
+		return list( expr );
+
+	case IOC::EMap:
+		return map( expr );
+
+	case IOC::EObject:
+		return object( expr, std::string() );
+
+	default:
+		return literal( expr );
+	}
+}
+
+std::string ConfigCompiler::literal( expr_cref expr ) const
+{
+	std::ostringstream oss;
+	switch( expr.type() )
+	{
+	case IOC::EInt:
+		if( expr.intValue() == std::numeric_limits< long long >::min() )
+		{
+			oss << "( " << expr.intValue() + 1 << "LL - 1 )";
+		}
+		else
+		{
+			oss << expr.intValue() << "LL";
+		}
+		break;
+
+	case IOC::EReal:
+		if( !std::isfinite( expr.realValue() ) )
+		{
+			oss << expr.value() << " is not a finite number";
+			throw std::invalid_argument( oss.str() );
+		}
+		oss << std::setprecision( std::numeric_limits< double >::max_digits10 ) << expr.realValue();
+		if( oss.str().find_first_of( ".e" ) == std::string::npos )
+		{
+			oss << ".0";
+		}
+		break;
+
+	case IOC::EBool:
+		oss << ( expr.boolValue() ? "true" : "false" );
+		break;
+
+	case IOC::EString: case IOC::EConcat:
+		{
+			std::string str;
+			m_loader->convert( expr, str );
+			oss << stringLiteral( str );
+		}
+		break;
+
+	default:
+		oss << expr.value() << " cannot be the value of a parameter";
+		throw std::invalid_argument( oss.str() );
+	}
+	return oss.str();
+}
+
+// A List of literals all of one type is written once as an array
+bool ConfigCompiler::literalArray( std::vector< RecursiveExpressionPtr > const& elements, std::string & res )
+{
+	static const char * const arrayTypes[] = { "const char * const", "const bool", "const long long", "const double" };
+
+	IOC::ExpressionType type = IOC::EError;
+	std::vector< const IOC::RecursiveExpression * > values;
+	for( RecursiveExpressionPtr const& element : elements )
+	{
+		expr_cref target = m_loader->underlying( *element, NULL, false );
+		IOC::ExpressionType targetType = target.type() == IOC::EConcat ? IOC::EString : target.type();
+		if( targetType > IOC::EReal || ( !values.empty() && targetType != type ) )
+		{
+			return false;
+		}
+		type = targetType;
+		values.push_back( &target );
+	}
+
+	std::ostringstream oss;
+	oss << arrayTypes[ type ] << " l" << m_arrays.size() << "[] = {";
+	for( size_t i = 0; i < values.size(); ++i )
+	{
+		oss << ( i ? ", " : " " ) << ( i && i % 8 == 0 ? "\n\t" : "" ) << literal( *values[i] );
+	}
+	oss << " };";
+
+	std::ostringstream name;
+	name << "iocc::literals( l" << m_arrays.size() << " )";
+	m_arrays.push_back( oss.str() );
+	res = name.str();
+	return true;
+}
+
+std::string ConfigCompiler::list( expr_cref expr )
+{
+	std::vector< RecursiveExpressionPtr > elements;
+	m_loader->toVector( expr, elements );
+
+	std::string res;
+	if( elements.size() > 1 && literalArray( elements, res ) )
+	{
+		return res;
+	}
+
+	std::vector< std::string > values;
+	for( RecursiveExpressionPtr const& element : elements )
+	{
+		values.push_back( value( *element ) );
+	}
+	return call( "iocc::list", values );
+}
+
+std::string ConfigCompiler::map( expr_cref expr )
+{
+	std::vector< std::pair< RecursiveExpressionPtr, RecursiveExpressionPtr > > pairs;
+	m_loader->toMap( expr, pairs );
+
+	std::vector< std::string > entries;
+	for( std::pair< RecursiveExpressionPtr, RecursiveExpressionPtr > const& entry : pairs )
+	{
+		entries.push_back( "iocc::entry( " + value( *entry.first ) + ", " + value( *entry.second ) + " )" );
+	}
+	return call( "iocc::map", entries );
+}
+
+std::string ConfigCompiler::object( expr_cref expr, str_cref name )
+{
+	if( !name.empty() )
+	{
+		std::map< std::string, size_t >::const_iterator found = m_named.find( name );
+		if( found != m_named.end() )
+		{
+			return "o" + std::to_string( found->second );
+		}
+		if( !m_compiling.insert( name ).second )
+		{
+			throw std::invalid_argument( "Circular reference detected for " + name );
+		}
+	}
+
+	CompiledObject obj;
+	obj.m_label = name.empty() ? "(" + expr.value() + ")" : name;
+	obj.m_builder = builderFor( expr.value() );
+
+	IOC::ExpressionSpan params = expr.params();
+	for( size_t i = 0; i < params.size(); ++i )
+	{
+		try
+		{
+			obj.m_args.push_back( value( params.at( i ) ) );
+		}
+		catch( std::exception const& err )
+		{
+			std::ostringstream oss;
+			oss << err.what() << "\n\tin parameter " << i + 1 << " of " << obj.m_label;
+			throw std::invalid_argument( oss.str() );
+		}
+	}
+
+	const size_t idx = m_objects.size();
+	m_objects.push_back( obj );
+	if( !name.empty() )
+	{
+		m_named.insert( std::make_pair( name, idx ) );
+		m_compiling.erase( name );
+	}
+	return "o" + std::to_string( idx );
+}
+
+// the number of the typedef for the builder of a class
+size_t ConfigCompiler::builderFor( str_cref className )
+{
+	expr_cref expr = m_loader->lookup( className );
+	if( expr.type() != IOC::EClass )
+	{
+		std::ostringstream oss;
+		oss << className << " is not a class";
+		throw std::invalid_argument( oss.str() );
+	}
+
+	std::string symbol;
+	m_loader->convert( *expr.param( 1 ), symbol );
+	std::map< std::string, size_t >::const_iterator found = m_builderIds.find( symbol );
+	if( found != m_builderIds.end() )
+	{
+		return found->second;
+	}
+
+	std::map< std::string, std::string >::const_iterator type = m_manifest.find( symbol );
+	if( type == m_manifest.end() )
+	{
+		std::ostringstream oss;
+		oss << "Symbol " << symbol << " of class " << className << " in library "
+			<< expr.param( 0 )->value() << " is not in the manifest";
+		throw std::invalid_argument( oss.str() );
+	}
+
+	m_builderIds.insert( std::make_pair( symbol, m_builders.size() ) );
+	m_builders.push_back( std::make_pair( type->second, className ) );
+	return m_builders.size() - 1;
+}
+
+void ConfigCompiler::write( std::ostream & os, str_cref function, bool withMain ) const
+{
+	os << "// Generated by ioc-compile from " << m_configFile << " for " << m_name << ". Do not edit.\n"
+		<< "// Generate it again if the config or the manifest changes.\n\n"
+		<< "#include <IOC/Compiled.h>\n";
+	for( str_cref header : m_headers )
+	{
+		os << "#include " << ( header.compare( 0, 1, "<" ) == 0 ? header : stringLiteral( header ) ) << '\n';
+	}
+
+	os << "\nnamespace {\n\n";
+	for( size_t i = 0; i < m_builders.size(); ++i )
+	{
+		os << "typedef " << m_builders[i].first << " B" << i << "; // " << m_builders[i].second << '\n';
+	}
+	for( str_cref array : m_arrays )
+	{
+		os << '\n' << array << '\n';
+	}
+
+	// The objects are kept in a struct and constructed a few at a time by its members, as a
+	// single function constructing thousands takes the compiler minutes to optimise
+	static const size_t perPart = 32;
+	const size_t numParts = ( m_objects.size() + perPart - 1 ) / perPart;
+
+	os << "\nstruct Objects\n{\n";
+	for( size_t idx = 0; idx < m_objects.size(); ++idx )
+	{
+		os << "\tB" << m_objects[idx].m_builder << "::sptr_type o" << idx << "; // " << m_objects[idx].m_label << '\n';
+	}
+	os << '\n';
+	for( size_t part = 0; part < numParts; ++part )
+	{
+		os << "\tvoid construct" << part << "();\n";
+	}
+	os << "};\n";
+
+	for( size_t idx = 0; idx < m_objects.size(); ++idx )
+	{
+		if( idx % perPart == 0 )
+		{
+			os << ( idx ? "}\n" : "" ) << "\nvoid Objects::construct" << idx / perPart
+				<< "()\n{\n\tnamespace iocc = IOC::compiled;\n";
+		}
+
+		CompiledObject const& obj = m_objects[idx];
+		size_t length = 0;
+		for( str_cref arg : obj.m_args )
+		{
+			length += arg.size() + 2;
+		}
+
+		os << "\n\t// " << obj.m_label << "\n\to" << idx << " = iocc::create< B" << obj.m_builder << " >(";
+		for( size_t i = 0; i < obj.m_args.size(); ++i )
+		{
+			os << ( i ? "," : "" ) << ( length > 80 ? "\n\t\t" : " " ) << obj.m_args[i];
+		}
+		os << ( obj.m_args.empty() ? ");\n" : length > 80 ? "\n\t);\n" : " );\n" );
+	}
+
+	os << "}\n\n}\n\nIOC::RunnablePtr " << function << "()\n{\n\tObjects objects;\n";
+	for( size_t part = 0; part < numParts; ++part )
+	{
+		os << "\tobjects.construct" << part << "();\n";
+	}
+	os << "\treturn objects." << m_result << ";\n}\n";
+
+	if( withMain )
+	{
+		os << "\nint main()\n{\n\treturn " << function << "()->run();\n}\n";
+	}
+}
+
+std::string functionFor( str_cref name )
+{
+	std::string res( "make" );
+	for( char ch : name )
+	{
+		res += std::isalnum( static_cast< unsigned char >( ch ) ) ? ch : '_';
+	}
+	return res;
+}
+
+}
+
+int main( int argc, char* argv[] )
+{
+	bool withMain = false;
+	std::string function;
+	int arg = 1;
+	for( ; arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'; ++arg )
+	{
+		std::string option( argv[arg] );
+		if( option == "--main" )
+		{
+			withMain = true;
+		}
+		else if( option == "--function" && arg + 1 < argc )
+		{
+			function = argv[++arg];
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if( argc - arg != 3 )
+	{
+		std::cerr << "Usage " << argv[0] << " [--main] [--function name] manifestFile configFile name\n";
+		return 2;
+	}
+
+	std::string manifestFile( argv[arg] );
+	std::string configFile( argv[arg + 1] );
+	std::string name( argv[arg + 2] );
+
+	// the progress of loading is not wanted here
+	std::clog.rdbuf( NULL );
+
+	std::unique_ptr< ConfigCompiler > compiler;
+	try
+	{
+		compiler.reset( new ConfigCompiler( manifestFile, configFile ) );
+	}
+	catch( std::exception const& ex )
+	{
+		std::cerr << "ERROR: " << ex.what() << std::endl;
+		return 2;
+	}
+
+	try
+	{
+		compiler->compile( name );
+		compiler->write( std::cout, function.empty() ? functionFor( name ) : function, withMain );
+		return 0;
+	}
+	catch( std::exception const& ex )
+	{
+		std::cerr << "ERROR: " << ex.what() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,487 @@
+#include "stdafx.h"
+
+#include <IOC/ioc_api.h>
+#include <IOC/Builder.h>
+#include <IOC/detail/ObjectLoader.h>
+#include <IOC/detail/RecursiveExpression.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+// ioc-graph loads a config and binds every object defined in it, which opens the libraries,
+// finds the classes and checks each is given the right number and types of parameters, but
+// constructs nothing. It then writes the graph of what each object is made from, the order
+// they can be built in, level by level, and the definitions nothing uses.
+//
+// Objects in the same level do not depend on each other so can be constructed at the same
+// time (see setConstructionThreads), and the widest level is how many threads can be kept
+// busy. Unused definitions are those not reachable from the names given, or from any object
+// if none are. They still cost parse time. Objects in a circular reference, and those made
+// from them, cannot be built so are in no level, and the circular reference is reported as
+// getRunnable() would report it.
+//
+// Usage: ioc-graph [--dot | --json] configFile [name...]
+// It exits with 1 if any object fails to bind, and 2 if the config cannot be loaded.
+
+namespace {
+
+using IOC::Builder;
+using IOC::BuilderPtr;
+using IOC::RecursiveExpression;
+using IOC::RecursiveExpressionPtr;
+using IOC::expr_cref;
+using IOC::str_cref;
+
+struct GraphNode
+{
+	const Builder * m_builder;
+	std::string m_name; // empty if it is anonymous
+	std::string m_class;
+	std::vector< size_t > m_deps;
+	bool m_depsKnown;
+	size_t m_level; // 0 if it is made from no other objects, else one more than the highest of them
+	bool m_circular; // in a circular reference or made from something that is, so has no level
+
+	std::string label() const
+	{
+		return m_name.empty() ? "(" + m_class + ")" : m_name;
+	}
+};
+
+class ConfigGraph
+{
+public:
+	ConfigGraph( str_cref configFile, std::vector< std::string > const& roots );
+
+	void writeText( std::ostream & os ) const;
+	void writeDot( std::ostream & os, str_cref title ) const;
+	void writeJSON( std::ostream & os ) const;
+
+	bool hasErrors() const
+	{
+		return !m_errors.empty();
+	}
+
+private:
+	bool bindAll( str_cref configFile, std::vector< std::string > const& objects, bool reload );
+	size_t addNode( Builder const& builder );
+	void markUsed( str_cref name );
+	void markUsed( expr_cref expr );
+
+	void addError( str_cref name, std::exception const& err );
+	size_t widestLevel() const;
+
+	IOC::ObjectLoaderPtr m_loader;
+	std::set< std::string > m_defined;
+	std::vector< RecursiveExpressionPtr > m_variables; // the builders refer to them
+	std::vector< BuilderPtr > m_bound;
+	std::map< std::string, std::string > m_errors;
+
+	std::vector< GraphNode > m_nodes;
+	std::unordered_map< const Builder *, size_t > m_numbered;
+	std::vector< size_t > m_adding; // the nodes being added, the innermost last
+	std::vector< std::vector< size_t > > m_levels;
+
+	std::set< std::string > m_used;
+	std::vector< std::string > m_unused;
+};
+
+ConfigGraph::ConfigGraph( str_cref configFile, std::vector< std::string > const& roots )
+	: m_loader( IOC::getObjectLoader( configFile ) )
+{
+	std::vector< std::string > names;
+	m_loader->definitions( names );
+	m_defined.insert( names.begin(), names.end() );
+
+	std::vector< std::string > objects;
+	for( str_cref name : m_defined )
+	{
+		try
+		{
+			if( m_loader->lookup( name ).type() == IOC::EObject )
+			{
+				objects.push_back( name );
+			}
+		}
+		catch( std::exception const& err )
+		{
+			addError( name, err );
+		}
+	}
+
+	bool reload = false;
+	while( !bindAll( configFile, objects, reload ) )
+	{
+		reload = true;
+	}
+
+	for( size_t idx = 0; idx < m_nodes.size(); ++idx )
+	{
+		if( m_nodes[idx].m_circular )
+		{
+			continue;
+		}
+		if( m_levels.size() <= m_nodes[idx].m_level )
+		{
+			m_levels.resize( m_nodes[idx].m_level + 1 );
+		}
+		m_levels[ m_nodes[idx].m_level ].push_back( idx );
+	}
+
+	for( str_cref name : roots.empty() ? objects : roots )
+	{
+		if( !m_defined.count( name ) )
+		{
+			std::ostringstream oss;
+			oss << name << " is not defined in the config";
+			throw std::invalid_argument( oss.str() );
+		}
+		markUsed( name );
+	}
+	std::set_difference( m_defined.begin(), m_defined.end(), m_used.begin(), m_used.end(),
+		std::back_inserter( m_unused ) );
+}
+
+// Binds each object the way getRunnable() does, so a named object has one builder however
+// it is reached. One that fails is left half bound in the loader, and would then appear to
+// bind from anything else using it, so after a failure it starts again with a new loader
+// and binds only those that have not failed. Returns false if it has to start again.
+bool ConfigGraph::bindAll( str_cref configFile, std::vector< std::string > const& objects, bool reload )
+{
+	if( reload )
+	{
+		m_nodes.clear();
+		m_numbered.clear();
+		m_adding.clear();
+		m_bound.clear();
+		m_variables.clear();
+		m_loader = IOC::getObjectLoader( configFile );
+	}
+
+	for( str_cref name : objects )
+	{
+		if( m_errors.count( name ) )
+		{
+			continue;
+		}
+
+		try
+		{
+			m_variables.push_back( RecursiveExpression::create( name, IOC::EVariable ) );
+			BuilderPtr builder = m_loader->getBuilder( *m_variables.back() );
+			m_bound.push_back( builder );
+			addNode( *builder );
+		}
+		catch( std::exception const& err )
+		{
+			addError( name, err );
+			return false;
+		}
+	}
+	return true;
+}
+
+size_t ConfigGraph::addNode( Builder const& builder )
+{
+	std::unordered_map< const Builder *, size_t >::const_iterator found = m_numbered.find( &builder );
+	if( found != m_numbered.end() )
+	{
+		// reached again while it is being added, so it and all added since are in the circle
+		std::vector< size_t >::const_iterator adding = std::find( m_adding.begin(), m_adding.end(), found->second );
+		if( adding != m_adding.end() )
+		{
+			for( ; adding != m_adding.end(); ++adding )
+			{
+				m_nodes[ *adding ].m_circular = true;
+			}
+			addError( builder.alias(), std::invalid_argument( "Circular reference detected for " + builder.alias() ) );
+		}
+		return found->second;
+	}
+
+	const size_t idx = m_nodes.size();
+	m_numbered.insert( std::make_pair( &builder, idx ) );
+	m_nodes.push_back( GraphNode() );
+	m_nodes[idx].m_builder = &builder;
+	m_nodes[idx].m_name = builder.alias();
+	m_nodes[idx].m_class = builder.type();
+	m_nodes[idx].m_level = 0;
+	m_nodes[idx].m_circular = false;
+
+	std::vector< const Builder * > deps;
+	m_nodes[idx].m_depsKnown = builder.dependencies( deps );
+	if( m_nodes[idx].m_depsKnown )
+	{
+		m_adding.push_back( idx );
+		for( const Builder * dep : deps )
+		{
+			size_t depIdx = addNode( *dep );
+			m_nodes[idx].m_deps.push_back( depIdx );
+			if( m_nodes[depIdx].m_circular )
+			{
+				m_nodes[idx].m_circular = true;
+			}
+			else
+			{
+				m_nodes[idx].m_level = std::max( m_nodes[idx].m_level, m_nodes[depIdx].m_level + 1 );
+			}
+		}
+		m_adding.pop_back();
+		std::sort( m_nodes[idx].m_deps.begin(), m_nodes[idx].m_deps.end() );
+		m_nodes[idx].m_deps.erase( std::unique( m_nodes[idx].m_deps.begin(), m_nodes[idx].m_deps.end() ),
+			m_nodes[idx].m_deps.end() );
+	}
+	return idx;
+}
+
+void ConfigGraph::markUsed( str_cref name )
+{
+	if( !m_defined.count( name ) || !m_used.insert( name ).second )
+	{
+		return; // an enum value, or already seen
+	}
+
+	try
+	{
+		markUsed( m_loader->lookup( name ) );
+	}
+	catch( std::exception const& err )
+	{
+		addError( name, err );
+	}
+}
+
+// a folded Concat is walked as it was written so the names in it are seen
+void ConfigGraph::markUsed( expr_cref start )
+{
+	expr_cref expr = start.foldedFrom() ? *start.foldedFrom() : start;
+	if( expr.type() == IOC::EVariable || expr.type() == IOC::EObject ) // an object is named by its class
+	{
+		markUsed( expr.value() );
+	}
+
+	IOC::ExpressionSpan params = expr.params();
+	for( size_t i = 0; i < params.size(); ++i )
+	{
+		markUsed( params.at( i ) );
+	}
+}
+
+void ConfigGraph::addError( str_cref name, std::exception const& err )
+{
+	std::string message( err.what() );
+	message.erase( message.find_last_not_of( "\n" ) + 1 );
+	m_errors.insert( std::make_pair( name, message ) );
+}
+
+size_t ConfigGraph::widestLevel() const
+{
+	size_t widest = 0;
+	for( size_t level = 1; level < m_levels.size(); ++level )
+	{
+		if( m_levels[level].size() > m_levels[widest].size() )
+		{
+			widest = level;
+		}
+	}
+	return widest;
+}
+
+void ConfigGraph::writeText( std::ostream & os ) const
+{
+	os << m_nodes.size() << " objects in " << m_levels.size() << " levels";
+	if( !m_levels.empty() )
+	{
+		size_t widest = widestLevel();
+		os << ", maximum parallel width " << m_levels[widest].size() << " at level " << widest;
+	}
+	os << "\n\nBuild order:\n";
+	for( size_t level = 0; level < m_levels.size(); ++level )
+	{
+		os << level << ':';
+		for( size_t idx : m_levels[level] )
+		{
+			os << ' ' << m_nodes[idx].label();
+		}
+		os << '\n';
+	}
+
+	os << "\nUnused definitions:\n";
+	for( str_cref name : m_unused )
+	{
+		os << '\t' << name << '\n';
+	}
+
+	if( !m_errors.empty() )
+	{
+		os << "\nErrors:\n";
+		for( std::map< std::string, std::string >::const_iterator iter = m_errors.begin();
+			iter != m_errors.end(); ++iter )
+		{
+			os << iter->first << ": " << iter->second << '\n';
+		}
+	}
+}
+
+std::string quoted( str_cref str )
+{
+	std::ostringstream oss;
+	oss << '"';
+	for( char ch : str )
+	{
+		if( ch == '"' || ch == '\\' )
+		{
+			oss << '\\' << ch;
+		}
+		else if( ch == '\n' )
+		{
+			oss << "\\n";
+		}
+		else if( ch == '\t' )
+		{
+			oss << "\\t";
+		}
+		else if( static_cast< unsigned char >( ch ) >= 0x20 )
+		{
+			oss << ch;
+		}
+	}
+	oss << '"';
+	return oss.str();
+}
+
+// edges go from each object to those it is made from
+void ConfigGraph::writeDot( std::ostream & os, str_cref title ) const
+{
+	os << "digraph " << quoted( title ) << " {\n";
+	for( size_t idx = 0; idx < m_nodes.size(); ++idx )
+	{
+		GraphNode const& node = m_nodes[idx];
+		os << "\tn" << idx << " [label=" << quoted( node.label() + '\n' + node.m_class );
+		if( node.m_name.empty() )
+		{
+			os << ", style=dashed";
+		}
+		os << "];\n";
+		for( size_t dep : node.m_deps )
+		{
+			os << "\tn" << idx << " -> n" << dep << ";\n";
+		}
+	}
+	os << "}\n";
+}
+
+void ConfigGraph::writeJSON( std::ostream & os ) const
+{
+	os << "{\n\t\"objects\": [";
+	for( size_t idx = 0; idx < m_nodes.size(); ++idx )
+	{
+		GraphNode const& node = m_nodes[idx];
+		os << ( idx ? "," : "" ) << "\n\t\t{ \"id\": " << idx << ", \"name\": " << quoted( node.m_name )
+			<< ", \"class\": " << quoted( node.m_class ) << ", \"level\": ";
+		if( node.m_circular )
+		{
+			os << "null";
+		}
+		else
+		{
+			os << node.m_level;
+		}
+		os << ", \"dependencies\": ";
+		if( node.m_depsKnown )
+		{
+			os << '[';
+			for( size_t i = 0; i < node.m_deps.size(); ++i )
+			{
+				os << ( i ? ", " : " " ) << node.m_deps[i];
+			}
+			os << ( node.m_deps.empty() ? "]" : " ]" );
+		}
+		else
+		{
+			os << "null";
+		}
+		os << " }";
+	}
+
+	os << "\n\t],\n\t\"build_order\": [";
+	for( size_t level = 0; level < m_levels.size(); ++level )
+	{
+		os << ( level ? "," : "" ) << "\n\t\t[";
+		for( size_t i = 0; i < m_levels[level].size(); ++i )
+		{
+			os << ( i ? ", " : " " ) << m_levels[level][i];
+		}
+		os << " ]";
+	}
+
+	os << "\n\t],\n\t\"max_parallel_width\": " << ( m_levels.empty() ? 0 : m_levels[ widestLevel() ].size() )
+		<< ",\n\t\"unused\": [";
+	for( size_t i = 0; i < m_unused.size(); ++i )
+	{
+		os << ( i ? ", " : " " ) << quoted( m_unused[i] );
+	}
+
+	os << ( m_unused.empty() ? "]" : " ]" ) << ",\n\t\"errors\": [";
+	for( std::map< std::string, std::string >::const_iterator iter = m_errors.begin();
+		iter != m_errors.end(); ++iter )
+	{
+		os << ( iter == m_errors.begin() ? "" : "," ) << "\n\t\t{ \"name\": " << quoted( iter->first )
+			<< ", \"error\": " << quoted( iter->second ) << " }";
+	}
+	os << ( m_errors.empty() ? "]" : "\n\t]" ) << "\n}\n";
+}
+
+}
+
+int main( int argc, char* argv[] )
+{
+	enum { EText, EDot, EJSON } format = EText;
+	int arg = 1;
+	if( arg < argc && std::string( argv[arg] ) == "--dot" )
+	{
+		format = EDot;
+		++arg;
+	}
+	else if( arg < argc && std::string( argv[arg] ) == "--json" )
+	{
+		format = EJSON;
+		++arg;
+	}
+
+	if( arg >= argc )
+	{
+		std::cerr << "Usage " << argv[0] << " [--dot | --json] configFile [name...]\n";
+		return 2;
+	}
+
+	std::string configFile( argv[arg++] );
+	std::vector< std::string > roots( argv + arg, argv + argc );
+
+	// the progress of binding is not wanted here
+	std::clog.rdbuf( NULL );
+
+	try
+	{
+		ConfigGraph graph( configFile, roots );
+		switch( format )
+		{
+		case EDot:
+			graph.writeDot( std::cout, configFile );
+			break;
+		case EJSON:
+			graph.writeJSON( std::cout );
+			break;
+		default:
+			graph.writeText( std::cout );
+		}
+		return graph.hasErrors() ? 1 : 0;
+	}
+	catch( std::exception const& ex )
+	{
+		std::cerr << "ERROR: " << ex.what() << std::endl;
+		return 2;
+	}
+}